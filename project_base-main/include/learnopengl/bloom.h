@@ -0,0 +1,123 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+#include <learnopengl/rendertargets.h>
+
+#include <vector>
+#include <iostream>
+#include <algorithm>
+using namespace std;
+
+// progressive bloom on a mip pyramid. the bright pass is filtered down the chain with a 13-tap box
+// filter, every mip at half the size of the previous one, and then walked back up with a 3x3 tent
+// filter that is added onto the next larger mip. the result ends up in mip 0 (half resolution) and
+// holds the sum of all levels, so the composite divides it by Levels().
+// the mips are transient, borrowed from the render target pool in Render and handed back with Release
+// once the composite has read the result.
+class BloomChain
+{
+public:
+    struct Mip {
+        glm::ivec2 size;
+        unsigned int texture;
+    };
+
+    int mipCount;
+    // tent radius of the upsample filter in uv units
+    float filterRadius = 0.005f;
+    vector<Mip> mips;
+
+    BloomChain(int mipCount = 6) : mipCount(mipCount)
+    {
+    }
+
+    void Destroy()
+    {
+        glDeleteFramebuffers(1, &FBO);
+        FBO = 0;
+    }
+
+    // number of levels summed up in Result()
+    int Levels() const { return (int) mips.size(); }
+
+    // the filtered bloom, valid after Render
+    unsigned int Result() const { return mips[0].texture; }
+
+    // runs the whole chain on the bright pass texture. both shaders are drawn with drawQuad over
+    // a full screen quad. leaves the framebuffer unbound and the viewport at the size of mip 0.
+    // sourceUvScale is the part of the source that holds the image when the scene was rendered at a
+    // reduced resolution, the first downsample stretches it over the whole chain.
+    void Render(RenderTargetPool &pool, Shader &downsampleShader, Shader &upsampleShader, unsigned int sourceTexture,
+                int sourceWidth, int sourceHeight, const glm::vec2 &sourceUvScale, void (*drawQuad)())
+    {
+        acquire(pool, sourceWidth, sourceHeight);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_BLEND);
+        glActiveTexture(GL_TEXTURE0);
+
+        downsampleShader.use();
+        downsampleShader.setInt("srcTexture", 0);
+        glm::ivec2 sourceSize(sourceWidth, sourceHeight);
+        glBindTexture(GL_TEXTURE_2D, sourceTexture);
+        for (size_t i = 0; i < mips.size(); i++) {
+            glViewport(0, 0, mips[i].size.x, mips[i].size.y);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mips[i].texture, 0);
+            downsampleShader.setVec2("srcTexelSize", glm::vec2(1.0f / sourceSize.x, 1.0f / sourceSize.y));
+            downsampleShader.setVec2("srcUvScale", i == 0 ? sourceUvScale : glm::vec2(1.0f));
+            drawQuad();
+            sourceSize = mips[i].size;
+            glBindTexture(GL_TEXTURE_2D, mips[i].texture);
+        }
+
+        // add every level onto the next larger one
+        upsampleShader.use();
+        upsampleShader.setInt("srcTexture", 0);
+        upsampleShader.setFloat("filterRadius", filterRadius);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        for (size_t i = mips.size() - 1; i > 0; i--) {
+            glBindTexture(GL_TEXTURE_2D, mips[i].texture);
+            glViewport(0, 0, mips[i - 1].size.x, mips[i - 1].size.y);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mips[i - 1].texture, 0);
+            drawQuad();
+        }
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glEnable(GL_DEPTH_TEST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // gives the mips back to the pool, Result() is invalid afterwards
+    void Release(RenderTargetPool &pool)
+    {
+        for (const Mip& mip : mips)
+            pool.Release(mip.texture);
+        mips.clear();
+    }
+
+private:
+    unsigned int FBO = 0;
+
+    void acquire(RenderTargetPool &pool, int width, int height)
+    {
+        Release(pool);
+        if (FBO == 0)
+            glGenFramebuffers(1, &FBO);
+        glm::ivec2 size(width, height);
+        for (int i = 0; i < mipCount; i++) {
+            size = glm::ivec2(std::max(size.x / 2, 1), std::max(size.y / 2, 1));
+            Mip mip;
+            mip.size = size;
+            mip.texture = pool.Acquire(size.x, size.y, HDR_COLOR_FORMAT);
+            mips.push_back(mip);
+            if (size.x == 1 && size.y == 1)
+                break;
+        }
+    }
+};
+#endif
@@ -0,0 +1,213 @@
+#ifndef CAMERAPATH_H
+#define CAMERAPATH_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/camera.h>
+#include <learnopengl/log.h>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+using namespace std;
+
+// recorded camera flythroughs for performance runs that can be compared between builds.
+// while recording every frame stores the time since the recording started, the animation time that
+// drives the sun and the swing, the camera pose and the render toggles. the path can be split into
+// segments (a corridor, the open park, ...) that get their own statistics.
+// replay ignores the real frame time: frame i shows the path at i * fixedStep, interpolated between the
+// recorded frames, so every build renders exactly the same sequence of frames. the time every replayed
+// frame took is written per frame and summed up per segment, so two runs can be diffed frame by frame.
+class CameraPath
+{
+public:
+    static constexpr float fixedStep = 1.0f / 60.0f;
+
+    struct Keyframe {
+        float time;
+        float animationTime;
+        int segment;
+        glm::vec3 position;
+        float yaw;
+        float pitch;
+        float zoom;
+        unsigned int toggles;
+    };
+
+    vector<Keyframe> keyframes;
+
+    bool Recording() const { return recording; }
+    bool Replaying() const { return replaying; }
+
+    void StartRecording(float now)
+    {
+        keyframes.clear();
+        recording = true;
+        replaying = false;
+        recordingStart = now;
+        segment = 0;
+    }
+
+    void StopRecording() { recording = false; }
+
+    // everything recorded from here on belongs to the next segment
+    void NewSegment()
+    {
+        if (recording)
+            segment++;
+    }
+
+    void Record(float now, float animationTime, const Camera &camera, unsigned int toggles)
+    {
+        if (!recording)
+            return;
+        Keyframe keyframe;
+        keyframe.time = now - recordingStart;
+        keyframe.animationTime = animationTime;
+        keyframe.segment = segment;
+        keyframe.position = camera.Position;
+        keyframe.yaw = camera.Yaw;
+        keyframe.pitch = camera.Pitch;
+        keyframe.zoom = camera.Zoom;
+        keyframe.toggles = toggles;
+        keyframes.push_back(keyframe);
+    }
+
+    // one keyframe per line: time, animation time, segment, position, yaw, pitch, zoom, toggles
+    bool Save(const string &path) const
+    {
+        std::ofstream file(path);
+        if (!file)
+            return false;
+        file << "camera_path 1\n";
+        for (const Keyframe& k : keyframes)
+            file << k.time << ' ' << k.animationTime << ' ' << k.segment << ' ' << k.position.x << ' '
+                 << k.position.y << ' ' << k.position.z << ' ' << k.yaw << ' ' << k.pitch << ' ' << k.zoom << ' '
+                 << k.toggles << '\n';
+        return true;
+    }
+
+    bool Load(const string &path)
+    {
+        std::ifstream file(path);
+        string magic;
+        int version = 0;
+        file >> magic >> version;
+        if (!file || magic != "camera_path" || version != 1)
+            return false;
+        keyframes.clear();
+        Keyframe k;
+        while (file >> k.time >> k.animationTime >> k.segment >> k.position.x >> k.position.y >> k.position.z
+                    >> k.yaw >> k.pitch >> k.zoom >> k.toggles)
+            keyframes.push_back(k);
+        return !keyframes.empty();
+    }
+
+    // number of frames a replay renders
+    int FrameCount() const
+    {
+        return keyframes.empty() ? 0 : (int) (keyframes.back().time / fixedStep) + 1;
+    }
+
+    void StartReplay()
+    {
+        if (keyframes.empty())
+            return;
+        recording = false;
+        replaying = true;
+        replayFrame = 0;
+        frameMilliseconds.clear();
+        frameSegments.clear();
+    }
+
+    // at the start of every frame while replaying. poses the camera and returns the animation time and
+    // toggles of the frame. once the path is done the statistics are written and false is returned.
+    bool ReplayFrame(Camera &camera, float &animationTime, unsigned int &toggles)
+    {
+        Clock::time_point now = Clock::now();
+        // the frame before this one is over
+        if (replayFrame > 0 && (int) frameMilliseconds.size() < replayFrame)
+            frameMilliseconds.push_back(std::chrono::duration<float, std::milli>(now - frameStart).count());
+        frameStart = now;
+        if (replayFrame >= FrameCount()) {
+            Finish();
+            return false;
+        }
+
+        float time = replayFrame * fixedStep;
+        // last keyframe at or before time
+        size_t next = std::upper_bound(keyframes.begin(), keyframes.end(), time,
+                                       [](float t, const Keyframe &k) { return t < k.time; }) - keyframes.begin();
+        const Keyframe& a = keyframes[next > 0 ? next - 1 : 0];
+        const Keyframe& b = keyframes[std::min(next, keyframes.size() - 1)];
+        float f = b.time > a.time ? (time - a.time) / (b.time - a.time) : 0.0f;
+        f = std::max(0.0f, std::min(1.0f, f));
+        camera.SetPose(a.position + (b.position - a.position) * f, a.yaw + (b.yaw - a.yaw) * f,
+                       a.pitch + (b.pitch - a.pitch) * f, a.zoom + (b.zoom - a.zoom) * f);
+        animationTime = a.animationTime + (b.animationTime - a.animationTime) * f;
+        toggles = a.toggles;
+        frameSegments.push_back(a.segment);
+        replayFrame++;
+        return true;
+    }
+
+    // stops the replay and writes the statistics, the time of a frame is only known at the start of the next
+    // one, so a loop that ends right after the last frame calls this itself
+    void Finish()
+    {
+        if (!replaying)
+            return;
+        if ((int) frameMilliseconds.size() < replayFrame)
+            frameMilliseconds.push_back(std::chrono::duration<float, std::milli>(Clock::now() - frameStart).count());
+        replaying = false;
+        writeReport();
+    }
+
+    // prefix of the <prefix>_frames.csv and <prefix>_segments.csv reports
+    string reportPrefix = "replay";
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    bool recording = false;
+    bool replaying = false;
+    float recordingStart = 0.0f;
+    int segment = 0;
+    int replayFrame = 0;
+    Clock::time_point frameStart;
+    vector<float> frameMilliseconds;
+    vector<int> frameSegments;
+
+    void writeReport() const
+    {
+        std::ofstream frames(reportPrefix + "_frames.csv");
+        frames << "frame,segment,ms\n";
+        for (size_t i = 0; i < frameMilliseconds.size(); i++)
+            frames << i << ',' << frameSegments[i] << ',' << frameMilliseconds[i] << '\n';
+
+        std::ofstream segments(reportPrefix + "_segments.csv");
+        segments << "segment,frames,min_ms,avg_ms,p99_ms,max_ms\n";
+        int segmentCount = frameSegments.empty() ? 0 : *std::max_element(frameSegments.begin(), frameSegments.end()) + 1;
+        for (int s = 0; s < segmentCount; s++) {
+            vector<float> times;
+            for (size_t i = 0; i < frameMilliseconds.size(); i++)
+                if (frameSegments[i] == s)
+                    times.push_back(frameMilliseconds[i]);
+            if (times.empty())
+                continue;
+            std::sort(times.begin(), times.end());
+            float sum = 0.0f;
+            for (float t : times)
+                sum += t;
+            float p99 = times[std::max(0, (int) std::ceil(0.99f * times.size()) - 1)];
+            segments << s << ',' << times.size() << ',' << times.front() << ',' << sum / times.size() << ','
+                     << p99 << ',' << times.back() << '\n';
+            LOG_INFO("replay segment {}: {} frames, min {} ms, avg {} ms, p99 {} ms", s, times.size(), times.front(),
+                     sum / times.size(), p99);
+        }
+    }
+};
+#endif
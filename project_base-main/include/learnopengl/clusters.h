@@ -0,0 +1,363 @@
+#ifndef CLUSTERS_H
+#define CLUSTERS_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/lights.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/profiler.h>
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define CLUSTERS_SSE 1
+#endif
+using namespace std;
+
+// clustered forward shading: the view frustum is split into countX * countY screen tiles and countZ
+// exponential depth slices. every frame the lights are binned into the clusters on the CPU, spread
+// over a few worker threads, and the result is uploaded as texture buffers that the lighting shader
+// walks for its cluster only.
+class ClusterGrid
+{
+public:
+    static const int countX = 16;
+    static const int countY = 9;
+    static const int countZ = 24;
+    static const int clusterCount = countX * countY * countZ;
+    static const int maxLightsPerCluster = 256;
+    // 3 RGBA32F texels per light: position/radius, color/cos inner, direction/cos outer
+    static const int texelsPerLight = 3;
+
+    // texture buffers read by 2.model_lighting_clustered.fs
+    unsigned int lightDataTexture = 0;
+    unsigned int clusterGridTexture = 0;
+    unsigned int lightIndexTexture = 0;
+
+    ClusterGrid(float zNear, float zFar, unsigned int threadCount = std::thread::hardware_concurrency())
+            : zNear(zNear), zFar(zFar)
+    {
+        clusterMin[0].resize(clusterCount); clusterMin[1].resize(clusterCount); clusterMin[2].resize(clusterCount);
+        clusterMax[0].resize(clusterCount); clusterMax[1].resize(clusterCount); clusterMax[2].resize(clusterCount);
+        clusterLights.resize(clusterCount * maxLightsPerCluster);
+        clusterCounts.resize(clusterCount);
+        grid.resize(clusterCount * 2);
+
+        createTextureBuffer(lightDataBuffer, lightDataTexture, GL_RGBA32F);
+        createTextureBuffer(clusterGridBuffer, clusterGridTexture, GL_RG32UI);
+        createTextureBuffer(lightIndexBuffer, lightIndexTexture, GL_R32UI);
+
+        // the calling thread takes a share of the work as well
+        threadCount = std::max(1u, std::min(threadCount, 8u));
+        for (unsigned int i = 1; i < threadCount; i++)
+            workers.push_back(std::thread(&ClusterGrid::workerLoop, this, (int)i));
+        workerCount = threadCount;
+    }
+
+    ~ClusterGrid()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+            generation++;
+        }
+        wake.notify_all();
+        for (std::thread &worker : workers)
+            worker.join();
+    }
+
+    ClusterGrid(const ClusterGrid&) = delete;
+    ClusterGrid& operator=(const ClusterGrid&) = delete;
+
+    // uploads the world space light data, only needed when lights are added, removed or moved
+    void SetLights(const vector<LocalLight> &lights)
+    {
+        this->lights = lights;
+        vector<float> data;
+        data.reserve(lights.size() * texelsPerLight * 4);
+        for (const LocalLight &light : lights) {
+            float texels[texelsPerLight * 4] = {
+                    light.position.x, light.position.y, light.position.z, light.radius,
+                    light.color.r, light.color.g, light.color.b, light.cosInnerCutOff,
+                    light.direction.x, light.direction.y, light.direction.z, light.cosOuterCutOff
+            };
+            data.insert(data.end(), texels, texels + texelsPerLight * 4);
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, lightDataBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, data.size() * sizeof(float), data.empty() ? NULL : &data[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    // bins all lights into the clusters for this frame and uploads the cluster grid and index list
+    void Build(const glm::mat4 &view, const glm::mat4 &projection)
+    {
+        if (projection != cachedProjection) {
+            cachedProjection = projection;
+            buildClusterBounds(glm::inverse(projection));
+        }
+        prepareLights(view, projection);
+
+        // every worker owns a contiguous range of depth slices, so no two threads write the same cluster
+        runJob();
+
+        // compact the fixed size per cluster lists into one index list
+        indices.clear();
+        for (int i = 0; i < clusterCount; i++) {
+            grid[2 * i] = (uint32_t)indices.size();
+            grid[2 * i + 1] = clusterCounts[i];
+            const uint16_t *list = &clusterLights[i * maxLightsPerCluster];
+            for (uint32_t j = 0; j < clusterCounts[i]; j++)
+                indices.push_back(list[j]);
+        }
+
+        glBindBuffer(GL_TEXTURE_BUFFER, clusterGridBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, grid.size() * sizeof(uint32_t), &grid[0], GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, lightIndexBuffer);
+        // orphan and refill, an empty list still needs a valid buffer store
+        glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(indices.size(), 1) * sizeof(uint32_t), indices.empty() ? NULL : &indices[0], GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    // binds the three texture buffers starting at the given unit and sets the uniforms the shader needs
+    void Bind(Shader &shader, int firstUnit, int screenWidth, int screenHeight) const
+    {
+        glActiveTexture(GL_TEXTURE0 + firstUnit);
+        glBindTexture(GL_TEXTURE_BUFFER, lightDataTexture);
+        glActiveTexture(GL_TEXTURE0 + firstUnit + 1);
+        glBindTexture(GL_TEXTURE_BUFFER, clusterGridTexture);
+        glActiveTexture(GL_TEXTURE0 + firstUnit + 2);
+        glBindTexture(GL_TEXTURE_BUFFER, lightIndexTexture);
+        glActiveTexture(GL_TEXTURE0);
+
+        shader.setInt("lightData", firstUnit);
+        shader.setInt("clusterGrid", firstUnit + 1);
+        shader.setInt("lightIndices", firstUnit + 2);
+        shader.setInt("clusterCountX", countX);
+        shader.setInt("clusterCountY", countY);
+        shader.setInt("clusterCountZ", countZ);
+        shader.setVec2("clusterTileSize", (float)screenWidth / countX, (float)screenHeight / countY);
+        // slice = log(-z) * scale - bias
+        float logRatio = std::log(zFar / zNear);
+        shader.setFloat("clusterSliceScale", countZ / logRatio);
+        shader.setFloat("clusterSliceBias", countZ * std::log(zNear) / logRatio);
+    }
+
+    size_t IndexCount() const { return indices.size(); }
+
+private:
+    float zNear, zFar;
+    glm::mat4 cachedProjection = glm::mat4(0.0f);
+
+    // view space cluster AABBs, structure of arrays so four neighbouring clusters load as one SSE register
+    vector<float> clusterMin[3];
+    vector<float> clusterMax[3];
+
+    // per frame light data in view space with the cluster ranges each light can touch
+    struct LightRange {
+        float x, y, z, radius;
+        int minX, maxX, minY, maxY, minZ, maxZ;
+    };
+    vector<LocalLight> lights;
+    vector<LightRange> ranges;
+
+    vector<uint16_t> clusterLights;
+    vector<uint32_t> clusterCounts;
+    vector<uint32_t> grid;
+    vector<uint32_t> indices;
+
+    unsigned int lightDataBuffer = 0, clusterGridBuffer = 0, lightIndexBuffer = 0;
+
+    // worker pool
+    vector<std::thread> workers;
+    unsigned int workerCount = 1;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    uint64_t generation = 0;
+    unsigned int pending = 0;
+    bool quit = false;
+
+    void createTextureBuffer(unsigned int &buffer, unsigned int &texture, GLenum format)
+    {
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    float sliceDepth(int slice) const
+    {
+        return zNear * std::pow(zFar / zNear, (float)slice / countZ);
+    }
+
+    void buildClusterBounds(const glm::mat4 &inverseProjection)
+    {
+        for (int z = 0; z < countZ; z++) {
+            float nearDepth = sliceDepth(z);
+            float farDepth = sliceDepth(z + 1);
+            for (int y = 0; y < countY; y++) {
+                for (int x = 0; x < countX; x++) {
+                    glm::vec3 minPoint(1e30f), maxPoint(-1e30f);
+                    for (int corner = 0; corner < 4; corner++) {
+                        glm::vec2 ndc(-1.0f + 2.0f * (x + (corner & 1)) / countX, -1.0f + 2.0f * (y + (corner >> 1)) / countY);
+                        // ray through the tile corner, scaled to the slice's near and far depth
+                        glm::vec4 point = inverseProjection * glm::vec4(ndc.x, ndc.y, -1.0f, 1.0f);
+                        glm::vec3 ray = glm::vec3(point) / point.w;
+                        ray /= -ray.z;
+                        minPoint = glm::min(minPoint, glm::min(ray * nearDepth, ray * farDepth));
+                        maxPoint = glm::max(maxPoint, glm::max(ray * nearDepth, ray * farDepth));
+                    }
+                    int index = x + countX * (y + countY * z);
+                    for (int axis = 0; axis < 3; axis++) {
+                        clusterMin[axis][index] = minPoint[axis];
+                        clusterMax[axis][index] = maxPoint[axis];
+                    }
+                }
+            }
+        }
+    }
+
+    int sliceFromDepth(float depth) const
+    {
+        if (depth <= zNear)
+            return 0;
+        int slice = (int)std::floor(std::log(depth / zNear) / std::log(zFar / zNear) * countZ);
+        return std::min(std::max(slice, 0), countZ - 1);
+    }
+
+    void prepareLights(const glm::mat4 &view, const glm::mat4 &projection)
+    {
+        ranges.clear();
+        for (size_t i = 0; i < lights.size(); i++) {
+            const LocalLight &light = lights[i];
+            glm::vec3 center = glm::vec3(view * glm::vec4(light.position, 1.0f));
+            glm::vec4 rect;
+            if (center.z - light.radius > -zNear || center.z + light.radius < -zFar || !SphereScreenRect(center, light.radius, projection, zNear, rect)) {
+                // keeps indices aligned with the light data, an empty range is never visited
+                ranges.push_back({0, 0, 0, 0, 1, 0, 1, 0, 1, 0});
+                continue;
+            }
+            LightRange range;
+            range.x = center.x;
+            range.y = center.y;
+            range.z = center.z;
+            range.radius = light.radius;
+            range.minX = std::max(0, (int)std::floor((rect.x * 0.5f + 0.5f) * countX));
+            range.maxX = std::min(countX - 1, (int)std::floor((rect.z * 0.5f + 0.5f) * countX));
+            range.minY = std::max(0, (int)std::floor((rect.y * 0.5f + 0.5f) * countY));
+            range.maxY = std::min(countY - 1, (int)std::floor((rect.w * 0.5f + 0.5f) * countY));
+            range.minZ = sliceFromDepth(-center.z - light.radius);
+            range.maxZ = sliceFromDepth(-center.z + light.radius);
+            ranges.push_back(range);
+        }
+    }
+
+    void assignSlices(int firstSlice, int lastSlice)
+    {
+        for (int z = firstSlice; z < lastSlice; z++) {
+            std::memset(&clusterCounts[z * countX * countY], 0, countX * countY * sizeof(uint32_t));
+            for (size_t i = 0; i < ranges.size(); i++) {
+                const LightRange &range = ranges[i];
+                if (z < range.minZ || z > range.maxZ)
+                    continue;
+                for (int y = range.minY; y <= range.maxY; y++) {
+                    int row = countX * (y + countY * z);
+#ifdef CLUSTERS_SSE
+                    // four clusters of the row at a time, countX is a multiple of 4
+                    __m128 cx = _mm_set1_ps(range.x), cy = _mm_set1_ps(range.y), cz = _mm_set1_ps(range.z);
+                    __m128 radius2 = _mm_set1_ps(range.radius * range.radius);
+                    __m128 zero = _mm_setzero_ps();
+                    for (int x = range.minX & ~3; x <= range.maxX; x += 4) {
+                        int index = row + x;
+                        __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&clusterMin[0][index]), cx), _mm_sub_ps(cx, _mm_loadu_ps(&clusterMax[0][index]))), zero);
+                        __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&clusterMin[1][index]), cy), _mm_sub_ps(cy, _mm_loadu_ps(&clusterMax[1][index]))), zero);
+                        __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&clusterMin[2][index]), cz), _mm_sub_ps(cz, _mm_loadu_ps(&clusterMax[2][index]))), zero);
+                        __m128 distance2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+                        int mask = _mm_movemask_ps(_mm_cmple_ps(distance2, radius2));
+                        for (int lane = 0; lane < 4; lane++) {
+                            if ((mask & (1 << lane)) && x + lane >= range.minX && x + lane <= range.maxX)
+                                addLight(index + lane, i);
+                        }
+                    }
+#else
+                    for (int x = range.minX; x <= range.maxX; x++) {
+                        int index = row + x;
+                        float distance2 = 0.0f;
+                        const float center[3] = { range.x, range.y, range.z };
+                        for (int axis = 0; axis < 3; axis++) {
+                            float d = std::max(std::max(clusterMin[axis][index] - center[axis], center[axis] - clusterMax[axis][index]), 0.0f);
+                            distance2 += d * d;
+                        }
+                        if (distance2 <= range.radius * range.radius)
+                            addLight(index, i);
+                    }
+#endif
+                }
+            }
+        }
+    }
+
+    void addLight(int cluster, size_t light)
+    {
+        uint32_t &count = clusterCounts[cluster];
+        if (count < maxLightsPerCluster)
+            clusterLights[cluster * maxLightsPerCluster + count++] = (uint16_t)light;
+    }
+
+    void runShare(int worker)
+    {
+        PROFILE_ZONE("ClusterGrid::assignSlices");
+        int first = countZ * worker / (int)workerCount;
+        int last = countZ * (worker + 1) / (int)workerCount;
+        assignSlices(first, last);
+    }
+
+    void runJob()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending = workerCount - 1;
+            generation++;
+        }
+        wake.notify_all();
+        runShare(0);
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return pending == 0; });
+    }
+
+    void workerLoop(int worker)
+    {
+        PROFILE_THREAD_NAME("cluster worker");
+        uint64_t seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this, seen] { return generation != seen; });
+                seen = generation;
+                if (quit)
+                    return;
+            }
+            runShare(worker);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                pending--;
+            }
+            done.notify_one();
+        }
+    }
+};
+#endif
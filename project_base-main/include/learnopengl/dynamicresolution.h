@@ -0,0 +1,111 @@
+#ifndef DYNAMICRESOLUTION_H
+#define DYNAMICRESOLUTION_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cmath>
+
+// scales the internal render resolution to hold a target GPU frame time.
+// the frame is wrapped in a GL_TIME_ELAPSED query. results are read from a ring of queries a few frames
+// later, only once they are available, so the CPU never waits for the GPU. the cost of the scene is
+// roughly proportional to the pixel count, so the scale moves by the square root of the time ratio,
+// at most two steps at a time and only outside a small dead band. the scale is quantized so the frame
+// graph is not rebuilt for every tiny change. after a change the frames still in flight at the old scale
+// are thrown away, the first frame at the new one reseeds the average and settleSamples more are taken
+// before the next decision.
+class DynamicResolution
+{
+public:
+    static const int queryCount = 4;
+    static const int settleSamples = 8;
+
+    float targetMilliseconds;
+    float minScale;
+    float maxScale;
+    // fraction of the window size the scene is rendered at, per axis
+    float scale;
+    // smoothed GPU time of the measured frames
+    float gpuMilliseconds = 0.0f;
+
+    DynamicResolution(float targetMilliseconds = 16.0f, float minScale = 0.5f, float maxScale = 1.0f)
+            : targetMilliseconds(targetMilliseconds), minScale(minScale), maxScale(maxScale), scale(maxScale)
+    {
+        glGenQueries(queryCount, queries);
+        for (int i = 0; i < queryCount; i++)
+            pending[i] = false;
+    }
+
+    void BeginFrame()
+    {
+        // all queries still in flight, skip measuring this frame
+        if (pending[current])
+            return;
+        glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+        queryScaleChanges[current] = scaleChanges;
+        measuring = true;
+    }
+
+    // adjusts the scale from the oldest finished query. with enabled false the scale stays at maxScale.
+    void EndFrame(bool enabled)
+    {
+        if (measuring) {
+            glEndQuery(GL_TIME_ELAPSED);
+            pending[current] = true;
+            current = (current + 1) % queryCount;
+            measuring = false;
+        }
+
+        // the oldest query is the one that will be reused next
+        for (int i = 0; i < queryCount; i++) {
+            int query = (current + i) % queryCount;
+            if (!pending[query])
+                continue;
+            GLint available = 0;
+            glGetQueryObjectiv(queries[query], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break;
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(queries[query], GL_QUERY_RESULT, &elapsed);
+            pending[query] = false;
+            // rendered at an earlier scale
+            if (queryScaleChanges[query] != scaleChanges)
+                continue;
+            float milliseconds = elapsed / 1.0e6f;
+            gpuMilliseconds = samplesSinceChange == 0 ? milliseconds : gpuMilliseconds + 0.1f * (milliseconds - gpuMilliseconds);
+            samplesSinceChange++;
+        }
+
+        if (!enabled) {
+            scale = maxScale;
+            return;
+        }
+        // the average has to be made of frames at the current scale
+        if (samplesSinceChange < settleSamples || gpuMilliseconds <= 0.0f)
+            return;
+        float ratio = targetMilliseconds / gpuMilliseconds;
+        if (ratio > 0.95f && ratio < 1.05f)
+            return;
+        float wanted = std::round(scale * std::sqrt(ratio) / step) * step;
+        wanted = std::max(scale - 2.0f * step, std::min(scale + 2.0f * step, wanted));
+        wanted = std::max(minScale, std::min(maxScale, wanted));
+        if (wanted != scale) {
+            scale = wanted;
+            scaleChanges++;
+            samplesSinceChange = 0;
+        }
+    }
+
+private:
+    static constexpr float step = 1.0f / 32.0f;
+
+    unsigned int queries[queryCount];
+    bool pending[queryCount];
+    // scaleChanges when each query was begun
+    int queryScaleChanges[queryCount] = {};
+    int current = 0;
+    bool measuring = false;
+    int scaleChanges = 0;
+    int samplesSinceChange = 0;
+};
+#endif
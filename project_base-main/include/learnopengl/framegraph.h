@@ -0,0 +1,235 @@
+#ifndef FRAMEGRAPH_H
+#define FRAMEGRAPH_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/rendertargets.h>
+#include <learnopengl/gpuprofiler.h>
+#include <learnopengl/log.h>
+
+#include <string>
+#include <vector>
+#include <functional>
+using namespace std;
+
+// declarative description of the passes of a frame.
+// every pass lists the resources it reads and writes. Compile walks the passes backwards from the ones
+// with side effects (presenting to the window) and drops every pass whose outputs nobody reads, then
+// works out the first and last pass that touches each transient texture. Execute borrows a transient
+// texture from the render target pool right before its first pass and gives it back right after its last
+// one, so transients with disjoint lifetimes share the same memory. framebuffers are only rebound when
+// the next pass renders somewhere else than the previous one. with a profiler every pass is timed as a
+// zone of its own name.
+// the graph is meant to be rebuilt and compiled only when the configuration changes, the execute
+// callbacks read the per frame state through references.
+class FrameGraph
+{
+public:
+    // passes that bind their own framebuffers (shadow cascades, bloom mips) use this as their target
+    static const int OWN_FRAMEBUFFER = -1;
+
+    class PassBuilder
+    {
+    public:
+        PassBuilder(FrameGraph &graph, int pass) : graph(graph), pass(pass) {}
+
+        PassBuilder &Read(int resource)
+        {
+            graph.passes[pass].reads.push_back(resource);
+            return *this;
+        }
+
+        PassBuilder &Write(int resource)
+        {
+            graph.passes[pass].writes.push_back(resource);
+            return *this;
+        }
+
+        // framebuffer and viewport the pass draws into, 0 is the window
+        PassBuilder &Target(int framebuffer, int width, int height)
+        {
+            graph.passes[pass].framebuffer = framebuffer;
+            graph.passes[pass].width = width;
+            graph.passes[pass].height = height;
+            return *this;
+        }
+
+        // the pass is kept even if none of its outputs is read
+        PassBuilder &SideEffect()
+        {
+            graph.passes[pass].sideEffect = true;
+            return *this;
+        }
+
+        PassBuilder &Execute(function<void()> execute)
+        {
+            graph.passes[pass].execute = execute;
+            return *this;
+        }
+
+    private:
+        FrameGraph &graph;
+        int pass;
+    };
+
+    void Reset()
+    {
+        passes.clear();
+        resources.clear();
+        compiled = false;
+    }
+
+    // a texture that lives outside the graph, e.g. an attachment of the scene framebuffer
+    int Import(const string &name, unsigned int texture = 0)
+    {
+        Resource resource;
+        resource.name = name;
+        resource.texture = texture;
+        resource.transient = false;
+        resources.push_back(resource);
+        return (int) resources.size() - 1;
+    }
+
+    // a texture the graph allocates for the passes between its first and last use
+    int CreateTexture(const string &name, int width, int height, const TargetFormat &format)
+    {
+        Resource resource;
+        resource.name = name;
+        resource.width = width;
+        resource.height = height;
+        resource.format = format;
+        resource.transient = true;
+        resources.push_back(resource);
+        return (int) resources.size() - 1;
+    }
+
+    PassBuilder AddPass(const string &name)
+    {
+        Pass pass;
+        pass.name = name;
+        passes.push_back(pass);
+        return PassBuilder(*this, (int) passes.size() - 1);
+    }
+
+    void Compile()
+    {
+        // reference counts: a pass is needed if it has a side effect or writes something that a needed
+        // pass reads. passes are declared in execution order, so one backwards walk is enough.
+        vector<bool> resourceNeeded(resources.size(), false);
+        for (int p = (int) passes.size() - 1; p >= 0; p--) {
+            Pass& pass = passes[p];
+            bool needed = pass.sideEffect;
+            for (int resource : pass.writes)
+                needed = needed || resourceNeeded[resource];
+            pass.culled = !needed;
+            if (pass.culled)
+                continue;
+            for (int resource : pass.reads)
+                resourceNeeded[resource] = true;
+        }
+
+        for (Resource& resource : resources)
+            resource.firstPass = resource.lastPass = -1;
+        for (int p = 0; p < (int) passes.size(); p++) {
+            if (passes[p].culled)
+                continue;
+            for (int resource : passes[p].reads)
+                touch(resource, p);
+            for (int resource : passes[p].writes)
+                touch(resource, p);
+        }
+        compiled = true;
+    }
+
+    void Execute(RenderTargetPool &pool, GpuProfiler *profiler = nullptr)
+    {
+        if (!compiled)
+            Compile();
+        int boundFramebuffer = -2;
+        for (int p = 0; p < (int) passes.size(); p++) {
+            Pass& pass = passes[p];
+            if (pass.culled)
+                continue;
+            for (Resource& resource : resources)
+                if (resource.transient && resource.firstPass == p)
+                    resource.texture = pool.Acquire(resource.width, resource.height, resource.format);
+
+            if (profiler)
+                profiler->Begin(pass.name);
+            if (pass.framebuffer != OWN_FRAMEBUFFER && pass.framebuffer != boundFramebuffer) {
+                glBindFramebuffer(GL_FRAMEBUFFER, pass.framebuffer);
+                glViewport(0, 0, pass.width, pass.height);
+                framebufferBinds++;
+            }
+            if (pass.execute)
+                pass.execute();
+            if (profiler)
+                profiler->End();
+            // a pass that binds framebuffers itself leaves an unknown one behind
+            boundFramebuffer = pass.framebuffer == OWN_FRAMEBUFFER ? -2 : pass.framebuffer;
+
+            for (Resource& resource : resources) {
+                if (resource.transient && resource.lastPass == p) {
+                    pool.Release(resource.texture);
+                    resource.texture = 0;
+                }
+            }
+        }
+    }
+
+    // physical texture of a resource, transient ones are only valid during their passes
+    unsigned int Texture(int resource) const { return resources[resource].texture; }
+
+    bool IsCulled(const string &name) const
+    {
+        for (const Pass& pass : passes)
+            if (pass.name == name)
+                return pass.culled;
+        return true;
+    }
+
+    void Print() const
+    {
+        for (const Pass& pass : passes)
+            LOG_INFO("  {}{}", pass.culled ? "culled " : "", pass.name);
+    }
+
+    // framebuffer binds issued by Execute since the graph was created
+    long framebufferBinds = 0;
+
+private:
+    struct Resource {
+        string name;
+        unsigned int texture = 0;
+        bool transient = false;
+        int width = 0;
+        int height = 0;
+        TargetFormat format;
+        int firstPass = -1;
+        int lastPass = -1;
+    };
+
+    struct Pass {
+        string name;
+        vector<int> reads;
+        vector<int> writes;
+        int framebuffer = OWN_FRAMEBUFFER;
+        int width = 0;
+        int height = 0;
+        bool sideEffect = false;
+        bool culled = false;
+        function<void()> execute;
+    };
+
+    vector<Resource> resources;
+    vector<Pass> passes;
+    bool compiled = false;
+
+    void touch(int resource, int pass)
+    {
+        if (resources[resource].firstPass < 0)
+            resources[resource].firstPass = pass;
+        resources[resource].lastPass = pass;
+    }
+};
+#endif
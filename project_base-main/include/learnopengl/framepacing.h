@@ -0,0 +1,139 @@
+#ifndef FRAMEPACING_H
+#define FRAMEPACING_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <learnopengl/profiler.h>
+
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+// frame pacing: swap interval, an optional frame rate cap and a bound on the frames the GPU may lag behind.
+// the cap sleeps until shortly before the deadline and spins the rest of the way, sleep alone overshoots by
+// the scheduler granularity. after every swap a fence is inserted, and the CPU waits on the fence of the
+// frame framesInFlight - 1 frames back, so it never queues more than framesInFlight frames and input is
+// sampled at most that many frames before it shows up on screen.
+// the delta time handed to the camera is the mean of the last few frame times, one slow frame is spread
+// over several frames instead of making the camera jump.
+class FramePacer
+{
+public:
+    static const int maxFramesInFlight = 3;
+    static const int smoothingFrames = 8;
+
+    // 0 off, 1 every vblank, 2 every other vblank
+    int swapInterval = 1;
+    // frame rate cap, 0 for none
+    float targetFps = 0.0f;
+    // 1 to 3
+    int framesInFlight = 2;
+    bool smoothDeltaTime = true;
+
+    // last measured frame time and the one handed out, seconds
+    float rawDeltaTime = 0.0f;
+    float deltaTime = 0.0f;
+    // time spent in the limiter and waiting on fences in the last frame, milliseconds
+    float limiterMilliseconds = 0.0f;
+    float fenceMilliseconds = 0.0f;
+
+    // waits for the frame cap, then returns the delta time for this frame
+    float BeginFrame()
+    {
+        if (swapInterval != appliedSwapInterval) {
+            glfwSwapInterval(swapInterval);
+            appliedSwapInterval = swapInterval;
+        }
+
+        Clock::time_point now = Clock::now();
+        if (targetFps > 0.0f) {
+            PROFILE_ZONE("frame limiter");
+            Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / targetFps));
+            // after a hitch the schedule restarts instead of rushing frames to catch up
+            if (deadline + period < now)
+                deadline = now;
+            deadline += period;
+            while (deadline - Clock::now() > spinThreshold)
+                std::this_thread::sleep_for(deadline - Clock::now() - spinThreshold);
+            while (Clock::now() < deadline)
+                std::this_thread::yield();
+            Clock::time_point waited = Clock::now();
+            limiterMilliseconds = std::chrono::duration<float, std::milli>(waited - now).count();
+            now = waited;
+        } else {
+            limiterMilliseconds = 0.0f;
+        }
+
+        if (lastFrame == Clock::time_point())
+            lastFrame = now;
+        // long stalls (loading, dragging the window) are clamped so the camera doesn't fly off
+        rawDeltaTime = std::min(std::chrono::duration<float>(now - lastFrame).count(), 0.25f);
+        lastFrame = now;
+
+        history[historyOffset] = rawDeltaTime;
+        historyOffset = (historyOffset + 1) % smoothingFrames;
+        samples = std::min(samples + 1, smoothingFrames);
+        if (smoothDeltaTime) {
+            float sum = 0.0f;
+            for (int i = 0; i < samples; i++)
+                sum += history[i];
+            deltaTime = sum / samples;
+        } else {
+            deltaTime = rawDeltaTime;
+        }
+        return deltaTime;
+    }
+
+    // right after the buffer swap
+    void EndFrame()
+    {
+        PROFILE_ZONE("frames in flight");
+        int slot = frame % maxFramesInFlight;
+        // the fence of frame - maxFramesInFlight, already signaled unless framesInFlight is the maximum
+        Clock::time_point start = Clock::now();
+        wait(slot);
+        fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        int oldest = frame - (std::max(1, std::min(framesInFlight, maxFramesInFlight)) - 1);
+        if (oldest >= 0)
+            wait(oldest % maxFramesInFlight);
+        fenceMilliseconds = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+        frame++;
+    }
+
+    void Destroy()
+    {
+        for (int i = 0; i < maxFramesInFlight; i++) {
+            if (fences[i])
+                glDeleteSync(fences[i]);
+            fences[i] = 0;
+        }
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+    // below this the limiter spins, sleeping is not precise enough
+    const Clock::duration spinThreshold = std::chrono::microseconds(1500);
+
+    int appliedSwapInterval = -1;
+    Clock::time_point deadline;
+    Clock::time_point lastFrame;
+    float history[smoothingFrames] = {};
+    int historyOffset = 0;
+    int samples = 0;
+    GLsync fences[maxFramesInFlight] = {};
+    int frame = 0;
+
+    void wait(int slot)
+    {
+        if (!fences[slot])
+            return;
+        // the first wait flushes, so the fence is guaranteed to reach the GPU
+        GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+        while (glClientWaitSync(fences[slot], flags, 1000000) == GL_TIMEOUT_EXPIRED)
+            flags = 0;
+        glDeleteSync(fences[slot]);
+        fences[slot] = 0;
+    }
+};
+#endif
@@ -0,0 +1,84 @@
+#ifndef GBUFFER_H
+#define GBUFFER_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/rendertargets.h>
+#include <learnopengl/log.h>
+
+#include <iostream>
+
+// compact G-buffer for the deferred path, 12 bytes per pixel:
+//   attachment 0 - GL_RGBA8    albedo.rgb, specular intensity
+//   attachment 1 - GL_RGB10_A2 octahedral view space normal (rg), roughness (b)
+//   depth        - texture in the scene's depth format, position is reconstructed from it
+// the textures are transient, the frame graph allocates them for the deferred passes only and
+// they are attached to the G-buffer framebuffer every frame.
+const TargetFormat GBUFFER_ALBEDO_FORMAT = { GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE };
+const TargetFormat GBUFFER_NORMAL_FORMAT = { GL_RGB10_A2, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV };
+
+class GBuffer
+{
+public:
+    unsigned int FBO = 0;
+    unsigned int albedoSpec = 0;
+    unsigned int normalRoughness = 0;
+    unsigned int depth = 0;
+    int width = 0;
+    int height = 0;
+
+    void Create()
+    {
+        glGenFramebuffers(1, &FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, attachments);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void Destroy()
+    {
+        glDeleteFramebuffers(1, &FBO);
+        FBO = 0;
+    }
+
+    // attaches this frame's textures and leaves the framebuffer bound
+    void Attach(unsigned int albedoSpec, unsigned int normalRoughness, unsigned int depth, int width, int height)
+    {
+        this->albedoSpec = albedoSpec;
+        this->normalRoughness = normalRoughness;
+        this->depth = depth;
+        this->width = width;
+        this->height = height;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoSpec, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalRoughness, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            LOG_ERROR("G-buffer not complete!");
+    }
+
+    // binds the G-buffer textures to units 0, 1 and 2 for the lighting passes
+    void BindTextures() const
+    {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, albedoSpec);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, normalRoughness);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, depth);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // copies the depth into another framebuffer so forward passes (skybox, grass, sun) can depth test
+    // against the deferred geometry. the target depth attachment has to have the same format.
+    void BlitDepthTo(unsigned int targetFBO, int targetWidth, int targetHeight) const
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, targetFBO);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, targetWidth, targetHeight, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, targetFBO);
+    }
+};
+#endif
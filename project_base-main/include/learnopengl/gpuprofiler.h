@@ -0,0 +1,197 @@
+#ifndef GPUPROFILER_H
+#define GPUPROFILER_H
+
+#include <glad/glad.h>
+
+#include "imgui.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+using namespace std;
+
+// per pass GPU timings without stalling the pipeline.
+// every zone is a pair of GL_TIMESTAMP queries, so zones can be nested and don't collide with the
+// GL_TIME_ELAPSED query dynamic resolution keeps open over the whole frame. the queries of a frame are
+// read back bufferedFrames frames later, right before their query objects are reused. if the GPU still
+// hasn't finished them by then the results of that frame are dropped instead of waited for.
+class GpuProfiler
+{
+public:
+    static const int bufferedFrames = 3;
+    static const int historySize = 240;
+
+    struct Zone {
+        string name;
+        // nesting level, for the indentation in the overlay
+        int depth = 0;
+        // rolling average over the last historySize frames, milliseconds
+        float average = 0.0f;
+        float minimum = 0.0f;
+        float maximum = 0.0f;
+        // ring buffer of the last frames, oldest at historyOffset
+        vector<float> history = vector<float>(historySize, 0.0f);
+        int historyOffset = 0;
+        int samples = 0;
+    };
+
+    bool enabled = true;
+    vector<Zone> zones;
+
+    void BeginFrame()
+    {
+        slot = (slot + 1) % bufferedFrames;
+        readBack(frames[slot]);
+        frames[slot].used = 0;
+        open.clear();
+        depth = 0;
+    }
+
+    void Begin(const string &name)
+    {
+        if (!enabled)
+            return;
+        Frame& frame = frames[slot];
+        if (frame.used == (int) frame.ranges.size()) {
+            Range range;
+            glGenQueries(2, range.queries);
+            frame.ranges.push_back(range);
+        }
+        Range& range = frame.ranges[frame.used];
+        range.zone = zoneIndex(name);
+        range.ended = false;
+        depth++;
+        glQueryCounter(range.queries[0], GL_TIMESTAMP);
+        open.push_back(frame.used);
+        frame.used++;
+    }
+
+    void End()
+    {
+        if (!enabled || open.empty())
+            return;
+        Range& range = frames[slot].ranges[open.back()];
+        open.pop_back();
+        depth--;
+        glQueryCounter(range.queries[1], GL_TIMESTAMP);
+        range.ended = true;
+    }
+
+    // name, average, min, max and the whole history of every zone, one zone per line
+    bool ExportCsv(const string &path) const
+    {
+        std::ofstream file(path);
+        if (!file)
+            return false;
+        file << "pass,average_ms,min_ms,max_ms";
+        for (int i = 0; i < historySize; i++)
+            file << ",frame" << i;
+        file << '\n';
+        for (const Zone& zone : zones) {
+            file << zone.name << ',' << zone.average << ',' << zone.minimum << ',' << zone.maximum;
+            for (int i = 0; i < historySize; i++)
+                file << ',' << zone.history[(zone.historyOffset + i) % historySize];
+            file << '\n';
+        }
+        return true;
+    }
+
+    void DrawImGui()
+    {
+        ImGui::Begin("GPU profiler");
+        ImGui::Checkbox("Enabled", &enabled);
+        float total = 0.0f;
+        for (const Zone& zone : zones)
+            if (zone.depth == 0)
+                total += zone.average;
+        ImGui::Text("Frame: %.3f ms", total);
+        for (const Zone& zone : zones) {
+            ImGui::Text("%*s%-24s avg %6.3f  min %6.3f  max %6.3f ms", zone.depth * 2, "", zone.name.c_str(),
+                        zone.average, zone.minimum, zone.maximum);
+            ImGui::PlotHistogram(("##" + zone.name).c_str(), &zone.history[0], historySize, zone.historyOffset,
+                                 NULL, 0.0f, std::max(zone.maximum, 0.1f), ImVec2(0, 40));
+        }
+        if (ImGui::Button("Export CSV"))
+            ExportCsv("gpu_profile.csv");
+        ImGui::End();
+    }
+
+private:
+    struct Range {
+        unsigned int queries[2];
+        int zone;
+        // a zone left open at the end of the frame never wrote its second timestamp
+        bool ended = false;
+    };
+
+    struct Frame {
+        vector<Range> ranges;
+        int used = 0;
+    };
+
+    Frame frames[bufferedFrames];
+    int slot = 0;
+    int depth = 0;
+    vector<int> open;
+
+    int zoneIndex(const string &name)
+    {
+        for (int i = 0; i < (int) zones.size(); i++)
+            if (zones[i].name == name)
+                return i;
+        Zone zone;
+        zone.name = name;
+        zone.depth = depth;
+        zones.push_back(zone);
+        return (int) zones.size() - 1;
+    }
+
+    void readBack(Frame &frame)
+    {
+        int last = frame.used - 1;
+        while (last >= 0 && !frame.ranges[last].ended)
+            last--;
+        if (last < 0)
+            return;
+        // timestamps complete in order, the last one being done means the whole frame is
+        GLint available = 0;
+        glGetQueryObjectiv(frame.ranges[last].queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            return;
+        vector<float> frameTimes(zones.size(), 0.0f);
+        vector<bool> ran(zones.size(), false);
+        for (int i = 0; i < frame.used; i++) {
+            if (!frame.ranges[i].ended)
+                continue;
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(frame.ranges[i].queries[0], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(frame.ranges[i].queries[1], GL_QUERY_RESULT, &end);
+            // a zone may run several times per frame, its time is the sum
+            frameTimes[frame.ranges[i].zone] += (end - begin) / 1.0e6f;
+            ran[frame.ranges[i].zone] = true;
+        }
+        // zones that were skipped this frame (culled bloom, hidden overlay) keep their history as it is
+        for (int i = 0; i < (int) zones.size(); i++)
+            if (ran[i])
+                addSample(zones[i], frameTimes[i]);
+    }
+
+    void addSample(Zone &zone, float milliseconds)
+    {
+        zone.history[zone.historyOffset] = milliseconds;
+        zone.historyOffset = (zone.historyOffset + 1) % historySize;
+        zone.samples = std::min(zone.samples + 1, historySize);
+        float sum = 0.0f;
+        zone.minimum = 1e30f;
+        zone.maximum = 0.0f;
+        for (int i = 1; i <= zone.samples; i++) {
+            float sample = zone.history[(zone.historyOffset - i + historySize) % historySize];
+            sum += sample;
+            zone.minimum = std::min(zone.minimum, sample);
+            zone.maximum = std::max(zone.maximum, sample);
+        }
+        zone.average = sum / zone.samples;
+    }
+};
+#endif
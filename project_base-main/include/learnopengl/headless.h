@@ -0,0 +1,361 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <glad/glad.h>
+
+#ifdef ENABLE_HEADLESS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <learnopengl/gpuprofiler.h>
+#include <learnopengl/log.h>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+using namespace std;
+
+// headless mode for benchmarks and golden image checks on machines without a display or GPU.
+//
+//   ./project_base --headless --frames 300 --size 1280x720 --enable bloom,shadows --stats stats.json
+//                  --dump frame.ppm --golden golden/park.ppm --tolerance 0.02
+//
+// the context comes from EGL instead of GLFW: the Mesa surfaceless platform when it is there (llvmpipe
+// without X or a GPU), otherwise the default display with a pbuffer. the frame is composited into an
+// offscreen framebuffer of the requested size. frames run on a fixed 60 Hz clock without input, so the
+// same options always render the same images. every frame ends in glFinish, so the recorded times are
+// the full CPU + GPU cost of the frame.
+struct HeadlessOptions {
+    bool enabled = false;
+    int frames = 300;
+    // not included in the statistics, shader compilation and pool warm up land here
+    int warmupFrames = 30;
+    int width = 1280;
+    int height = 720;
+    string statsPath = "headless_stats.json";
+    // last frame as a binary PPM, empty for none
+    string dumpPath;
+    // PPM the last frame is compared against, empty for none
+    string goldenPath;
+    // largest mean absolute difference per channel, 0 to 1, that still passes
+    float tolerance = 0.02f;
+    // render features to switch on, names are interpreted by the caller
+    vector<string> features;
+    // camera path replayed from the first frame after warm up, with or without a window. a headless
+    // replay renders the whole path instead of frames frames.
+    string replayPath;
+    string replayReportPrefix = "replay";
+
+    // false on an unknown or malformed argument
+    bool Parse(int argc, char **argv)
+    {
+        for (int i = 1; i < argc; i++) {
+            string argument = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (argument == "--headless") {
+                enabled = true;
+            } else if (argument == "--frames" && hasValue) {
+                frames = std::max(1, atoi(argv[++i]));
+            } else if (argument == "--warmup" && hasValue) {
+                warmupFrames = std::max(0, atoi(argv[++i]));
+            } else if (argument == "--size" && hasValue) {
+                if (sscanf(argv[++i], "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) {
+                    LOG_ERROR("--size expects WIDTHxHEIGHT, got {}", argv[i]);
+                    return false;
+                }
+            } else if (argument == "--stats" && hasValue) {
+                statsPath = argv[++i];
+            } else if (argument == "--dump" && hasValue) {
+                dumpPath = argv[++i];
+            } else if (argument == "--golden" && hasValue) {
+                goldenPath = argv[++i];
+            } else if (argument == "--tolerance" && hasValue) {
+                tolerance = (float) atof(argv[++i]);
+            } else if (argument == "--replay" && hasValue) {
+                replayPath = argv[++i];
+            } else if (argument == "--replay-report" && hasValue) {
+                replayReportPrefix = argv[++i];
+            } else if (argument == "--enable" && hasValue) {
+                string list = argv[++i];
+                size_t start = 0;
+                while (start <= list.size()) {
+                    size_t end = std::min(list.find(',', start), list.size());
+                    if (end > start)
+                        features.push_back(list.substr(start, end - start));
+                    start = end + 1;
+                }
+            } else {
+                LOG_ERROR("unknown argument {}", argument);
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+class HeadlessContext
+{
+public:
+    // offscreen target the frame is composited into
+    unsigned int framebuffer = 0;
+    int width = 0;
+    int height = 0;
+
+    // creates the EGL context and makes it current, GL functions are not loaded yet
+    bool Create(int contextWidth, int contextHeight)
+    {
+        width = contextWidth;
+        height = contextHeight;
+#ifdef ENABLE_HEADLESS
+        const char *clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+        if (clientExtensions && strstr(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+            PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+                    (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+            if (getPlatformDisplay)
+                display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+        }
+        if (display == EGL_NO_DISPLAY)
+            display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        EGLint major, minor;
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+            LOG_ERROR("Failed to initialize EGL");
+            return false;
+        }
+        if (!eglBindAPI(EGL_OPENGL_API)) {
+            LOG_ERROR("EGL display has no desktop OpenGL");
+            return false;
+        }
+
+        const char *displayExtensions = eglQueryString(display, EGL_EXTENSIONS);
+        bool surfaceless = displayExtensions && strstr(displayExtensions, "EGL_KHR_surfaceless_context");
+        // the color and depth buffers are the offscreen framebuffer's, a pbuffer only has to exist
+        const EGLint configAttributes[] = {
+                EGL_SURFACE_TYPE, surfaceless ? EGL_DONT_CARE : EGL_PBUFFER_BIT,
+                EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                EGL_NONE
+        };
+        EGLConfig config;
+        EGLint configCount = 0;
+        if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0) {
+            LOG_ERROR("No EGL config for desktop OpenGL");
+            return false;
+        }
+
+        const EGLint contextAttributes[] = {
+                EGL_CONTEXT_MAJOR_VERSION, 3,
+                EGL_CONTEXT_MINOR_VERSION, 3,
+                EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                EGL_NONE
+        };
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+        if (context == EGL_NO_CONTEXT) {
+            LOG_ERROR("Failed to create an OpenGL 3.3 core context through EGL");
+            return false;
+        }
+        if (!surfaceless) {
+            const EGLint surfaceAttributes[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+            surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+            if (surface == EGL_NO_SURFACE) {
+                LOG_ERROR("Failed to create an EGL pbuffer");
+                return false;
+            }
+        }
+        if (!eglMakeCurrent(display, surface, surface, context)) {
+            LOG_ERROR("Failed to make the EGL context current");
+            return false;
+        }
+        LOG_INFO("headless EGL {}.{} context, {}", major, minor, surfaceless ? "surfaceless" : "pbuffer");
+        return true;
+#else
+        LOG_ERROR("built without headless support, reconfigure with -DENABLE_HEADLESS=ON");
+        return false;
+#endif
+    }
+
+    GLADloadproc Loader() const
+    {
+#ifdef ENABLE_HEADLESS
+        return (GLADloadproc) eglGetProcAddress;
+#else
+        return nullptr;
+#endif
+    }
+
+    // the offscreen framebuffer, after the GL functions are loaded
+    void CreateFramebuffer()
+    {
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glGenTextures(1, &color);
+        glBindTexture(GL_TEXTURE_2D, color);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+        glGenRenderbuffers(1, &depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            LOG_ERROR("Headless framebuffer not complete!");
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // RGB rows top to bottom
+    vector<unsigned char> ReadPixels() const
+    {
+        vector<unsigned char> pixels(width * height * 3);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        // GL reads bottom up, images are stored top down
+        for (int y = 0; y < height / 2; y++)
+            std::swap_ranges(pixels.begin() + y * width * 3, pixels.begin() + (y + 1) * width * 3,
+                             pixels.begin() + (height - 1 - y) * width * 3);
+        return pixels;
+    }
+
+    void Destroy()
+    {
+        if (framebuffer) {
+            glDeleteFramebuffers(1, &framebuffer);
+            glDeleteTextures(1, &color);
+            glDeleteRenderbuffers(1, &depth);
+            framebuffer = 0;
+        }
+#ifdef ENABLE_HEADLESS
+        if (display != EGL_NO_DISPLAY) {
+            eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            if (surface != EGL_NO_SURFACE)
+                eglDestroySurface(display, surface);
+            if (context != EGL_NO_CONTEXT)
+                eglDestroyContext(display, context);
+            eglTerminate(display);
+            display = EGL_NO_DISPLAY;
+        }
+#endif
+    }
+
+private:
+    unsigned int color = 0;
+    unsigned int depth = 0;
+#ifdef ENABLE_HEADLESS
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+    EGLSurface surface = EGL_NO_SURFACE;
+#endif
+};
+
+bool WritePpm(const string &path, int width, int height, const vector<unsigned char> &pixels)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    file << "P6\n" << width << ' ' << height << "\n255\n";
+    file.write((const char *) &pixels[0], pixels.size());
+    return true;
+}
+
+bool ReadPpm(const string &path, int &width, int &height, vector<unsigned char> &pixels)
+{
+    std::ifstream file(path, std::ios::binary);
+    string magic;
+    int maxValue = 0;
+    file >> magic >> width >> height >> maxValue;
+    if (!file || magic != "P6" || maxValue != 255 || width <= 0 || height <= 0)
+        return false;
+    file.get();
+    pixels.resize(width * height * 3);
+    file.read((char *) &pixels[0], pixels.size());
+    return (bool) file;
+}
+
+// mean absolute difference per channel, 0 to 1, and the share of pixels off by more than 10% in any channel
+void CompareImages(const vector<unsigned char> &a, const vector<unsigned char> &b, float &meanError, float &differingPixels)
+{
+    double sum = 0.0;
+    size_t differing = 0;
+    for (size_t i = 0; i < a.size(); i += 3) {
+        int largest = 0;
+        for (int c = 0; c < 3; c++) {
+            int difference = std::abs((int) a[i + c] - (int) b[i + c]);
+            sum += difference;
+            largest = std::max(largest, difference);
+        }
+        if (largest > 25)
+            differing++;
+    }
+    meanError = (float) (sum / (a.size() * 255.0));
+    differingPixels = (float) differing / (a.size() / 3);
+}
+
+// frame times after warm up, written as JSON together with the GPU time of every pass
+class FrameStatistics
+{
+public:
+    vector<float> milliseconds;
+    // cascades updated while the sun was up, and how many of them re-rendered their static casters
+    int shadowCascadeUpdates = 0;
+    int shadowStaticRedraws = 0;
+
+    bool WriteJson(const string &path, const HeadlessOptions &options, const GpuProfiler &profiler,
+                   const string &golden) const
+    {
+        std::ofstream file(path);
+        if (!file || milliseconds.empty())
+            return false;
+        vector<float> sorted = milliseconds;
+        std::sort(sorted.begin(), sorted.end());
+        double sum = 0.0;
+        for (float value : sorted)
+            sum += value;
+        double mean = sum / sorted.size();
+        double variance = 0.0;
+        for (float value : sorted)
+            variance += (value - mean) * (value - mean);
+
+        file << "{\n";
+        file << "  \"width\": " << options.width << ",\n";
+        file << "  \"height\": " << options.height << ",\n";
+        file << "  \"frames\": " << sorted.size() << ",\n";
+        file << "  \"warmup_frames\": " << options.warmupFrames << ",\n";
+        file << "  \"features\": [";
+        for (size_t i = 0; i < options.features.size(); i++)
+            file << (i ? ", " : "") << '"' << options.features[i] << '"';
+        file << "],\n";
+        file << "  \"mean_ms\": " << mean << ",\n";
+        file << "  \"stddev_ms\": " << std::sqrt(variance / sorted.size()) << ",\n";
+        file << "  \"min_ms\": " << sorted.front() << ",\n";
+        file << "  \"median_ms\": " << percentile(sorted, 0.5f) << ",\n";
+        file << "  \"p95_ms\": " << percentile(sorted, 0.95f) << ",\n";
+        file << "  \"p99_ms\": " << percentile(sorted, 0.99f) << ",\n";
+        file << "  \"max_ms\": " << sorted.back() << ",\n";
+        file << "  \"shadow_cascade_updates\": " << shadowCascadeUpdates << ",\n";
+        file << "  \"shadow_static_redraws\": " << shadowStaticRedraws << ",\n";
+        file << "  \"gpu_passes_ms\": {";
+        for (size_t i = 0; i < profiler.zones.size(); i++)
+            file << (i ? ", " : "") << '"' << profiler.zones[i].name << "\": " << profiler.zones[i].average;
+        file << "},\n";
+        if (!golden.empty())
+            file << "  \"golden\": " << golden << ",\n";
+        file << "  \"frame_ms\": [";
+        for (size_t i = 0; i < milliseconds.size(); i++)
+            file << (i ? ", " : "") << milliseconds[i];
+        file << "]\n}\n";
+        return true;
+    }
+
+private:
+    static float percentile(const vector<float> &sorted, float fraction)
+    {
+        size_t index = (size_t) std::ceil(fraction * sorted.size());
+        return sorted[std::min(sorted.size() - 1, index > 0 ? index - 1 : 0)];
+    }
+};
+#endif
@@ -0,0 +1,320 @@
+#ifndef HLOD_H
+#define HLOD_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+#include <learnopengl/model.h>
+#include <learnopengl/scene.h>
+#include <learnopengl/textureatlas.h>
+#include <learnopengl/profiler.h>
+#include <learnopengl/log.h>
+
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+using namespace std;
+
+// hierarchical LOD for the static props: the objects are grouped into cells of a grid on the ground and
+// every cell gets one proxy, all of its objects merged into a single mesh and simplified by vertex
+// clustering (every vertex inside the same clusterSize box collapses into one, triangles that lose a corner
+// are dropped). the proxy has no textures, each vertex carries the albedo of the diffuse map under it,
+// read back from the GPU while building, averaged over the cluster. past distance a cell draws its proxy
+// instead of its objects, so the far field costs at most one draw per cell.
+// objects that move are never merged and the shadows keep drawing the real meshes.
+class HLOD
+{
+public:
+    float cellSize = 16.0f;
+    float clusterSize = 0.2f;
+    // cells whose bounds are further than this draw the proxy
+    float distance = 40.0f;
+
+    // results of the last Select
+    int proxiesDrawn = 0;
+    int cellsProxied = 0;
+
+    // after the models are loaded and the texture atlas is built; sets hlodCell of the merged objects
+    void Build(vector<SceneObject> &objects, const TextureAtlas &atlas)
+    {
+        PROFILE_ZONE("HLOD::Build");
+        map<pair<int, int>, int> cellIndex;
+        for (SceneObject& object : objects) {
+            object.hlodCell = -1;
+            if (!object.isStatic)
+                continue;
+            glm::vec3 center = 0.5f * (object.boundsMin + object.boundsMax);
+            pair<int, int> key((int) std::floor(center.x / cellSize), (int) std::floor(center.z / cellSize));
+            map<pair<int, int>, int>::const_iterator found = cellIndex.find(key);
+            if (found == cellIndex.end()) {
+                found = cellIndex.insert(make_pair(key, (int) cells.size())).first;
+                cells.push_back(Cell());
+                cells.back().boundsMin = object.boundsMin;
+                cells.back().boundsMax = object.boundsMax;
+            }
+            object.hlodCell = found->second;
+            Cell &cell = cells[object.hlodCell];
+            cell.boundsMin = glm::min(cell.boundsMin, object.boundsMin);
+            cell.boundsMax = glm::max(cell.boundsMax, object.boundsMax);
+        }
+
+        readAtlas(atlas);
+        size_t sourceTriangles = 0, proxyTriangles = 0;
+        for (size_t c = 0; c < cells.size(); c++) {
+            vector<const SceneObject *> members;
+            for (const SceneObject& object : objects)
+                if (object.hlodCell == (int) c)
+                    members.push_back(&object);
+            sourceTriangles += buildProxy(cells[c], members, atlas);
+            proxyTriangles += cells[c].indexCount / 3;
+        }
+        // the pixels were only needed for the vertex colors
+        textures.clear();
+        atlasPixels.clear();
+        atlasPixels.shrink_to_fit();
+        LOG_INFO("hlod: {} cells, {} triangles merged into {}", cells.size(), sourceTriangles, proxyTriangles);
+    }
+
+    // decides per cell between the objects and the proxy, once per frame
+    void Select(const glm::mat4 &projection, const glm::mat4 &view, const glm::vec3 &cameraPosition)
+    {
+        Frustum frustum(projection * view);
+        cellsProxied = proxiesDrawn = 0;
+        for (Cell& cell : cells) {
+            cell.proxied = DistanceToBox(cameraPosition, cell.boundsMin, cell.boundsMax) > distance;
+            cell.visible = frustum.Intersects(cell.boundsMin, cell.boundsMax);
+            if (cell.proxied) {
+                cellsProxied++;
+                if (cell.visible)
+                    proxiesDrawn++;
+            }
+        }
+    }
+
+    // true when the cell draws its proxy this frame, -1 is no cell
+    bool CellProxied(int cell) const
+    {
+        return cell >= 0 && cells[cell].proxied;
+    }
+
+    // true when the object is drawn as part of its cell's proxy this frame
+    bool Proxied(const SceneObject &object) const
+    {
+        return CellProxied(object.hlodCell);
+    }
+
+    // the proxies of the far cells with an hlod.vs program in use
+    void Draw(Shader &shader, const glm::mat4 &projection, const glm::mat4 &view)
+    {
+        shader.setMat4("projection", projection);
+        shader.setMat4("view", view);
+        for (const Cell& cell : cells) {
+            if (!cell.proxied || !cell.visible || !cell.indexCount)
+                continue;
+            glBindVertexArray(cell.VAO);
+            glDrawElements(GL_TRIANGLES, cell.indexCount, GL_UNSIGNED_INT, 0);
+        }
+        glBindVertexArray(0);
+    }
+
+    int Cells() const { return (int) cells.size(); }
+
+    void Destroy()
+    {
+        for (Cell& cell : cells) {
+            glDeleteVertexArrays(1, &cell.VAO);
+            glDeleteBuffers(1, &cell.VBO);
+            glDeleteBuffers(1, &cell.EBO);
+        }
+        cells.clear();
+    }
+
+private:
+    struct Cell {
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+        unsigned int VAO = 0, VBO = 0, EBO = 0;
+        int indexCount = 0;
+        bool proxied = false;
+        bool visible = false;
+    };
+
+    struct ProxyVertex {
+        glm::vec3 position;
+        glm::vec3 normal;
+        glm::vec3 color;
+    };
+
+    // a coarse mip of a texture on the CPU
+    struct Pixels {
+        int width = 0;
+        int height = 0;
+        vector<unsigned char> rgba;
+    };
+
+    vector<Cell> cells;
+    // textures of their own by GL name, the atlas by layer
+    map<unsigned int, Pixels> textures;
+    vector<Pixels> atlasPixels;
+
+    // the atlas mips stop at 1/8, plenty for an average per vertex
+    void readAtlas(const TextureAtlas &atlas)
+    {
+        if (!atlas.ID)
+            return;
+        int level = 0;
+        glBindTexture(GL_TEXTURE_2D_ARRAY, atlas.ID);
+        glGetTexParameteriv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, &level);
+        int width = 0, height = 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D_ARRAY, level, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D_ARRAY, level, GL_TEXTURE_HEIGHT, &height);
+        vector<unsigned char> all(width * height * atlas.Layers() * 4);
+        glGetTexImage(GL_TEXTURE_2D_ARRAY, level, GL_RGBA, GL_UNSIGNED_BYTE, &all[0]);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        atlasPixels.resize(atlas.Layers());
+        for (int layer = 0; layer < atlas.Layers(); layer++) {
+            atlasPixels[layer].width = width;
+            atlasPixels[layer].height = height;
+            atlasPixels[layer].rgba.assign(all.begin() + layer * width * height * 4, all.begin() + (layer + 1) * width * height * 4);
+        }
+    }
+
+    // the first mip level no wider than 128 texels
+    const Pixels &readTexture(unsigned int id)
+    {
+        map<unsigned int, Pixels>::iterator found = textures.find(id);
+        if (found != textures.end())
+            return found->second;
+        Pixels &pixels = textures[id];
+        glBindTexture(GL_TEXTURE_2D, id);
+        int level = 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &pixels.width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &pixels.height);
+        while (pixels.width > 128 && pixels.height > 1) {
+            level++;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &pixels.width);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &pixels.height);
+        }
+        if (pixels.width > 0 && pixels.height > 0) {
+            pixels.rgba.resize(pixels.width * pixels.height * 4);
+            glGetTexImage(GL_TEXTURE_2D, level, GL_RGBA, GL_UNSIGNED_BYTE, &pixels.rgba[0]);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return pixels;
+    }
+
+    // nearest texel, uv wrapped like GL_REPEAT, inside rect (offset, size) of the image
+    static glm::vec3 sample(const Pixels &pixels, glm::vec2 uv, const glm::vec4 &rect)
+    {
+        if (pixels.rgba.empty())
+            return glm::vec3(0.5f);
+        uv -= glm::floor(uv);
+        int x = std::min(pixels.width - 1, (int) ((rect.x + uv.x * rect.z) * pixels.width));
+        int y = std::min(pixels.height - 1, (int) ((rect.y + uv.y * rect.w) * pixels.height));
+        const unsigned char *texel = &pixels.rgba[(y * pixels.width + x) * 4];
+        return glm::vec3(texel[0], texel[1], texel[2]) / 255.0f;
+    }
+
+    // merges and simplifies the members into the cell's proxy, returns the triangle count before
+    size_t buildProxy(Cell &cell, const vector<const SceneObject *> &members, const TextureAtlas &atlas)
+    {
+        struct Cluster {
+            glm::vec3 position = glm::vec3(0.0f);
+            glm::vec3 normal = glm::vec3(0.0f);
+            glm::vec3 color = glm::vec3(0.0f);
+            int count = 0;
+        };
+        unordered_map<uint64_t, unsigned int> clusterIndex;
+        vector<Cluster> clusters;
+        vector<unsigned int> indices;
+        size_t sourceTriangles = 0;
+        for (const SceneObject *object : members) {
+            glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(object->transform)));
+            for (const Mesh& mesh : object->model->meshes) {
+                // the proxy is opaque, blended meshes keep drawing in the transparent pass
+                if (mesh.materialClass == MATERIAL_BLENDED)
+                    continue;
+                // the diffuse map the mesh would be drawn with
+                const Pixels *pixels = nullptr;
+                glm::vec4 rect(0.0f, 0.0f, 1.0f, 1.0f);
+                for (const Texture& texture : mesh.textures) {
+                    if (texture.type != "texture_diffuse")
+                        continue;
+                    if (texture.atlasEntry >= 0) {
+                        const TextureAtlas::Entry &entry = atlas.Get(texture.atlasEntry);
+                        pixels = &atlasPixels[entry.layer];
+                        rect = entry.rect;
+                    } else {
+                        pixels = &readTexture(texture.id);
+                    }
+                    break;
+                }
+                vector<unsigned int> remap(mesh.vertices.size());
+                for (size_t v = 0; v < mesh.vertices.size(); v++) {
+                    const Vertex &vertex = mesh.vertices[v];
+                    glm::vec3 position = glm::vec3(object->transform * glm::vec4(vertex.Position, 1.0f));
+                    int x = (int) std::floor(position.x / clusterSize);
+                    int y = (int) std::floor(position.y / clusterSize);
+                    int z = (int) std::floor(position.z / clusterSize);
+                    // 21 bits per axis
+                    uint64_t key = ((uint64_t) (x & 0x1FFFFF) << 42) | ((uint64_t) (y & 0x1FFFFF) << 21) | (uint64_t) (z & 0x1FFFFF);
+                    unordered_map<uint64_t, unsigned int>::const_iterator found = clusterIndex.find(key);
+                    if (found == clusterIndex.end()) {
+                        found = clusterIndex.insert(make_pair(key, (unsigned int) clusters.size())).first;
+                        clusters.push_back(Cluster());
+                    }
+                    Cluster &cluster = clusters[found->second];
+                    cluster.position += position;
+                    cluster.normal += glm::normalize(normalMatrix * vertex.Normal);
+                    cluster.color += pixels ? sample(*pixels, vertex.TexCoords, rect) : glm::vec3(0.5f);
+                    cluster.count++;
+                    remap[v] = found->second;
+                }
+                for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+                    unsigned int a = remap[mesh.indices[i]], b = remap[mesh.indices[i + 1]], c = remap[mesh.indices[i + 2]];
+                    sourceTriangles++;
+                    if (a == b || b == c || a == c)
+                        continue;
+                    indices.push_back(a);
+                    indices.push_back(b);
+                    indices.push_back(c);
+                }
+            }
+        }
+
+        vector<ProxyVertex> vertices(clusters.size());
+        for (size_t i = 0; i < clusters.size(); i++) {
+            const Cluster &cluster = clusters[i];
+            vertices[i].position = cluster.position / (float) cluster.count;
+            // the two sides of a thin part cancel out, those clusters face up
+            float length = glm::length(cluster.normal);
+            vertices[i].normal = length > 1e-4f ? cluster.normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+            vertices[i].color = cluster.color / (float) cluster.count;
+        }
+        cell.indexCount = (int) indices.size();
+        if (indices.empty())
+            return sourceTriangles;
+
+        glGenVertexArrays(1, &cell.VAO);
+        glGenBuffers(1, &cell.VBO);
+        glGenBuffers(1, &cell.EBO);
+        glBindVertexArray(cell.VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, cell.VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(ProxyVertex), &vertices[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cell.EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ProxyVertex), (void*)offsetof(ProxyVertex, position));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(ProxyVertex), (void*)offsetof(ProxyVertex, normal));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(ProxyVertex), (void*)offsetof(ProxyVertex, color));
+        glBindVertexArray(0);
+        return sourceTriangles;
+    }
+};
+#endif
@@ -0,0 +1,262 @@
+#ifndef IMPOSTOR_H
+#define IMPOSTOR_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/shader.h>
+#include <learnopengl/model.h>
+#include <learnopengl/scene.h>
+#include <learnopengl/textureatlas.h>
+#include <learnopengl/profiler.h>
+#include <learnopengl/log.h>
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+using namespace std;
+
+// many copies of one model, drawn as octahedral impostors once they are far enough away.
+// Bake renders the model from framesPerSide x framesPerSide directions over the upper hemisphere into two
+// textures: albedo with coverage in alpha, and the normal with the depth along the view direction in alpha.
+// the directions come from a hemi-octahedral grid, frame (i, j) looks at the model from the direction whose
+// encoding is (i, j) / (framesPerSide - 1), see impostor.vs. at runtime every far instance is one camera
+// facing quad; the shader finds the four frames around the direction to the camera, projects the quad onto
+// each of them and blends them bilinearly. the depth moves gl_FragDepth onto the baked surface so the quads
+// sit in the terrain instead of cutting through it. instances within distance are drawn as meshes.
+// instances may only differ in position and rotation around y, everything else is baked in.
+class Impostor
+{
+public:
+    // units of the baked textures, between the material maps and the terrain's height map
+    static const int albedoUnit = 3;
+    static const int normalDepthUnit = 4;
+
+    // instances closer than this are drawn with the mesh
+    float distance = 25.0f;
+
+    // results of the last Select
+    int meshCount = 0;
+    int impostorCount = 0;
+
+    // bakeTransform is applied to the model before it is captured, for the scale shared by all instances
+    void Bake(Model &model, const glm::mat4 &bakeTransform, Shader &bakeShader, int framesPerSide = 8, int frameSize = 256)
+    {
+        PROFILE_ZONE("Impostor::Bake");
+        this->model = &model;
+        this->bakeTransform = bakeTransform;
+        this->framesPerSide = framesPerSide;
+        glm::vec3 boundsMin, boundsMax;
+        TransformBounds(bakeTransform, model.boundsMin, model.boundsMax, boundsMin, boundsMax);
+        center = 0.5f * (boundsMin + boundsMax);
+        radius = 0.5f * glm::length(boundsMax - boundsMin);
+
+        int size = framesPerSide * frameSize;
+        albedo = createTexture(size);
+        normalDepth = createTexture(size);
+        unsigned int framebuffer, depthBuffer;
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedo, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalDepth, 0);
+        glGenRenderbuffers(1, &depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+        unsigned int attachments[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+        glDrawBuffers(2, attachments);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            LOG_ERROR("impostor framebuffer not complete");
+
+        // the bake runs between frames, whatever it changes is put back
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        GLfloat clearColor[4];
+        glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+        GLboolean blend = glIsEnabled(GL_BLEND), cull = glIsEnabled(GL_CULL_FACE);
+        glDisable(GL_BLEND);
+        // leaves are seen from both sides
+        glDisable(GL_CULL_FACE);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        bakeShader.use();
+        bakeShader.setInt("atlas", TextureAtlas::unit);
+        bakeShader.setMat4("model", glm::translate(glm::mat4(1.0f), -center) * bakeTransform);
+        bakeShader.setMat4("projection", glm::ortho(-radius, radius, -radius, radius, 0.0f, 2.0f * radius));
+        bakeShader.setFloat("impostorRadius", radius);
+        for (int j = 0; j < framesPerSide; j++) {
+            for (int i = 0; i < framesPerSide; i++) {
+                glm::vec3 direction = frameDirection(i, j);
+                glm::vec3 up = std::fabs(direction.y) > 0.999f ? glm::vec3(0.0f, 0.0f, -1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+                glViewport(i * frameSize, j * frameSize, frameSize, frameSize);
+                bakeShader.setMat4("view", glm::lookAt(direction * radius, glm::vec3(0.0f), up));
+                bakeShader.setVec3("frameDirection", direction);
+                model.Draw(bakeShader);
+            }
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(1, &depthBuffer);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+        if (blend)
+            glEnable(GL_BLEND);
+        if (cull)
+            glEnable(GL_CULL_FACE);
+        for (unsigned int texture : {albedo, normalDepth}) {
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        LOG_INFO("impostor baked: {} frames of {}x{}, radius {}", framesPerSide * framesPerSide, frameSize, frameSize, radius);
+    }
+
+    void Add(const glm::vec3 &position, float yaw)
+    {
+        instances.push_back(glm::vec4(position, yaw));
+        // the world center, for culling and the distance test
+        centers.push_back(position + rotation(yaw) * center);
+    }
+
+    // after the instances are added
+    void Build()
+    {
+        float corners[] = {-1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f};
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &cornerVBO);
+        glGenBuffers(1, &instanceVBO);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, cornerVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+        // position and yaw of the visible far instances, rewritten by Select
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, std::max<size_t>(instances.size(), 1) * sizeof(glm::vec4), nullptr, GL_DYNAMIC_DRAW);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+        glVertexAttribDivisor(1, 1);
+        glBindVertexArray(0);
+    }
+
+    // splits the instances in the frustum into meshes and impostors, once per frame
+    void Select(const glm::mat4 &projection, const glm::mat4 &view, const glm::vec3 &cameraPosition)
+    {
+        PROFILE_ZONE("Impostor::Select");
+        Frustum frustum(projection * view);
+        meshTransforms.clear();
+        visible.clear();
+        for (size_t i = 0; i < instances.size(); i++) {
+            if (!frustum.Intersects(centers[i] - glm::vec3(radius), centers[i] + glm::vec3(radius)))
+                continue;
+            if (glm::length(centers[i] - cameraPosition) < distance) {
+                meshTransforms.push_back(glm::translate(glm::mat4(1.0f), glm::vec3(instances[i])) *
+                                         glm::rotate(glm::mat4(1.0f), instances[i].w, glm::vec3(0.0f, 1.0f, 0.0f)) * bakeTransform);
+            } else {
+                visible.push_back(instances[i]);
+            }
+        }
+        if (!visible.empty()) {
+            glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, visible.size() * sizeof(glm::vec4), &visible[0]);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+        meshCount = (int) meshTransforms.size();
+        impostorCount = (int) visible.size();
+    }
+
+    // the meshes of one material class of the near instances with the program in use. normalSpace is
+    // glm::mat3(view) for the view space normals of the G-buffer, identity for the world space lit shaders
+    void DrawMeshes(Shader &shader, const glm::mat3 &normalSpace, MaterialClass materialClass)
+    {
+        for (const glm::mat4& transform : meshTransforms) {
+            shader.setMat4("model", transform);
+            shader.setMat3("normalMatrix", normalSpace * glm::transpose(glm::inverse(glm::mat3(transform))));
+            model->Draw(shader, materialClass);
+        }
+    }
+
+    // the far instances with an impostor.vs program in use
+    void Draw(Shader &shader, const glm::mat4 &projection, const glm::mat4 &view, const glm::vec3 &cameraPosition)
+    {
+        if (visible.empty())
+            return;
+        shader.setMat4("projection", projection);
+        shader.setMat4("view", view);
+        shader.setVec3("impostorCamera", cameraPosition);
+        shader.setVec3("impostorCenter", center);
+        shader.setFloat("impostorRadius", radius);
+        shader.setFloat("framesPerSide", (float) framesPerSide);
+        glActiveTexture(GL_TEXTURE0 + albedoUnit);
+        glBindTexture(GL_TEXTURE_2D, albedo);
+        glActiveTexture(GL_TEXTURE0 + normalDepthUnit);
+        glBindTexture(GL_TEXTURE_2D, normalDepth);
+        glActiveTexture(GL_TEXTURE0);
+        glBindVertexArray(VAO);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei) visible.size());
+        glBindVertexArray(0);
+    }
+
+    int Instances() const { return (int) instances.size(); }
+
+    void Destroy()
+    {
+        if (VAO) {
+            glDeleteVertexArrays(1, &VAO);
+            glDeleteBuffers(1, &cornerVBO);
+            glDeleteBuffers(1, &instanceVBO);
+        }
+        if (albedo) {
+            glDeleteTextures(1, &albedo);
+            glDeleteTextures(1, &normalDepth);
+        }
+        VAO = cornerVBO = instanceVBO = albedo = normalDepth = 0;
+    }
+
+private:
+    Model *model = nullptr;
+    glm::mat4 bakeTransform = glm::mat4(1.0f);
+    int framesPerSide = 8;
+    // bounding sphere in the baked space
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 1.0f;
+    unsigned int albedo = 0, normalDepth = 0;
+    unsigned int VAO = 0, cornerVBO = 0, instanceVBO = 0;
+    // position in xyz, yaw in w
+    vector<glm::vec4> instances;
+    vector<glm::vec3> centers;
+    vector<glm::vec4> visible;
+    vector<glm::mat4> meshTransforms;
+
+    static glm::mat3 rotation(float yaw)
+    {
+        return glm::mat3(glm::rotate(glm::mat4(1.0f), yaw, glm::vec3(0.0f, 1.0f, 0.0f)));
+    }
+
+    // the inverse of the hemi-octahedral encoding in impostor.vs
+    glm::vec3 frameDirection(int i, int j) const
+    {
+        float a = 2.0f * i / (framesPerSide - 1) - 1.0f, b = 2.0f * j / (framesPerSide - 1) - 1.0f;
+        float x = 0.5f * (a + b), z = 0.5f * (a - b);
+        return glm::normalize(glm::vec3(x, 1.0f - std::fabs(x) - std::fabs(z), z));
+    }
+
+    static unsigned int createTexture(int size)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        // coarser levels would mix neighbouring frames
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 4);
+        return texture;
+    }
+};
+#endif
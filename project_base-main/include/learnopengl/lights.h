@@ -0,0 +1,70 @@
+#ifndef LIGHTS_H
+#define LIGHTS_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <algorithm>
+using namespace std;
+
+// a point or spot light with a finite radius of influence, used by the deferred and clustered paths.
+// attenuation falls smoothly to exactly zero at the radius so lights can be culled without popping.
+struct LocalLight {
+    glm::vec3 position;
+    float radius;
+    glm::vec3 color;
+    // spot cone, cosOuterCutOff == -1 means a point light
+    float cosInnerCutOff = -1.0f;
+    glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f);
+    float cosOuterCutOff = -1.0f;
+
+    bool IsSpot() const { return cosOuterCutOff > -1.0f; }
+};
+
+// lamp posts placed on a regular grid over the park, every post gets a warm point light under its head.
+vector<LocalLight> MakeLampPosts(int countX, int countZ, float spacing, float height = 2.5f, float radius = 5.0f)
+{
+    vector<LocalLight> lights;
+    float startX = -0.5f * spacing * (countX - 1);
+    float startZ = -0.5f * spacing * (countZ - 1);
+    for (int z = 0; z < countZ; z++) {
+        for (int x = 0; x < countX; x++) {
+            LocalLight light;
+            light.position = glm::vec3(startX + x * spacing, height, startZ + z * spacing);
+            light.radius = radius;
+            light.color = glm::vec3(1.0f, 0.8f, 0.55f) * 2.0f;
+            lights.push_back(light);
+        }
+    }
+    return lights;
+}
+
+// projects a sphere given in view space and returns its bounding rectangle in NDC (xy = min, zw = max).
+// returns false if the sphere is completely behind the near plane. if the camera is inside the sphere
+// the whole screen is returned.
+bool SphereScreenRect(const glm::vec3 &center, float radius, const glm::mat4 &projection, float zNear, glm::vec4 &rect)
+{
+    if (center.z - radius > -zNear)
+        return false;
+    if (glm::length(center) <= radius || center.z + radius > -zNear) {
+        rect = glm::vec4(-1.0f, -1.0f, 1.0f, 1.0f);
+        return true;
+    }
+    // project the eight corners of the view space bounding box, conservative but cheap
+    glm::vec2 minNdc(1.0f), maxNdc(-1.0f);
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 corner = center + radius * glm::vec3(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f);
+        corner.z = std::min(corner.z, -zNear);
+        glm::vec4 clip = projection * glm::vec4(corner, 1.0f);
+        glm::vec2 ndc = glm::vec2(clip.x, clip.y) / clip.w;
+        minNdc = glm::min(minNdc, ndc);
+        maxNdc = glm::max(maxNdc, ndc);
+    }
+    minNdc = glm::max(minNdc, glm::vec2(-1.0f));
+    maxNdc = glm::min(maxNdc, glm::vec2(1.0f));
+    if (minNdc.x >= maxNdc.x || minNdc.y >= maxNdc.y)
+        return false;
+    rect = glm::vec4(minNdc.x, minNdc.y, maxNdc.x, maxNdc.y);
+    return true;
+}
+#endif
@@ -0,0 +1,332 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <thread>
+
+// asynchronous logging.
+//
+//   LOG_INFO("hdr: {} | exposure: {}", hdr ? "on" : "off", exposure);
+//
+// the calling thread only copies the format pointer and the raw arguments into a slot of a lock-free
+// ring buffer (bounded multi producer queue with a sequence number per slot), a background thread does
+// the formatting and the writing to stdout. strings are copied since they may not outlive the call.
+// a call site that logs the same arguments again within repeatSeconds is not queued at all, the
+// number of suppressed repeats is appended to the next message that gets through.
+// messages below LOG_LEVEL are compiled out. when the ring is full messages are dropped and counted,
+// logging never blocks.
+
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_WARNING 2
+#define LOG_LEVEL_ERROR 3
+#define LOG_LEVEL_OFF 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+class Log
+{
+public:
+    static const int capacity = 512;
+    static const int maxArguments = 8;
+    static const int textSize = 1024;
+    static constexpr double repeatSeconds = 5.0;
+
+    // one per call site, created by the LOG_ macros
+    struct Site {
+        const char *format;
+        int level;
+        std::atomic<uint64_t> lastHash{0};
+        std::atomic<uint64_t> lastTime{0};
+        std::atomic<uint32_t> repeats{0};
+
+        Site(const char *format, int level) : format(format), level(level) {}
+    };
+
+    template<typename... Arguments>
+    static void Write(Site &site, const Arguments&... arguments)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        int hashed[] = {0, (hashArgument(hash, arguments), 0)...};
+        (void) hashed;
+
+        uint64_t now = Now();
+        uint64_t last = site.lastTime.load(std::memory_order_relaxed);
+        if (hash == site.lastHash.load(std::memory_order_relaxed) && last != 0 && now - last < repeatSeconds * 1e9) {
+            site.repeats.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        site.lastHash.store(hash, std::memory_order_relaxed);
+        site.lastTime.store(now, std::memory_order_relaxed);
+
+        Log& log = instance();
+        size_t position;
+        Cell *cell = log.claim(position);
+        if (!cell)
+            return;
+        Record& record = cell->record;
+        record.site = &site;
+        record.time = now;
+        record.repeats = site.repeats.exchange(0, std::memory_order_relaxed);
+        record.argumentCount = 0;
+        record.textUsed = 0;
+        int packed[] = {0, (packArgument(record, arguments), 0)...};
+        (void) packed;
+        cell->sequence.store(position + 1, std::memory_order_release);
+    }
+
+    // nanoseconds since the first log call
+    static uint64_t Now()
+    {
+        static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
+    }
+
+    ~Log()
+    {
+        quit.store(true);
+        writer.join();
+    }
+
+private:
+    struct Argument {
+        enum Type { SIGNED, UNSIGNED, REAL, BOOLEAN, TEXT } type;
+        union {
+            long long integer;
+            unsigned long long natural;
+            double real;
+            int text;
+        };
+    };
+
+    struct Record {
+        const Site *site;
+        uint64_t time;
+        uint32_t repeats;
+        int argumentCount;
+        Argument arguments[maxArguments];
+        int textUsed;
+        char text[textSize];
+    };
+
+    struct Cell {
+        std::atomic<size_t> sequence;
+        Record record;
+    };
+
+    Cell cells[capacity];
+    std::atomic<size_t> enqueuePosition{0};
+    size_t dequeuePosition = 0;
+    std::atomic<uint32_t> dropped{0};
+    std::atomic<bool> quit{false};
+    std::thread writer;
+
+    Log()
+    {
+        for (int i = 0; i < capacity; i++)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        writer = std::thread(&Log::writerLoop, this);
+    }
+
+    static Log &instance()
+    {
+        static Log log;
+        return log;
+    }
+
+    Cell *claim(size_t &position)
+    {
+        position = enqueuePosition.load(std::memory_order_relaxed);
+        while (true) {
+            Cell *cell = &cells[position % capacity];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t difference = (intptr_t) sequence - (intptr_t) position;
+            if (difference == 0) {
+                if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    return cell;
+            } else if (difference < 0) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            } else {
+                position = enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    static void hashBytes(uint64_t &hash, const void *data, size_t size)
+    {
+        const unsigned char *bytes = (const unsigned char *) data;
+        for (size_t i = 0; i < size; i++)
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+
+    template<typename T>
+    static void hashArgument(uint64_t &hash, const T &value) { hashBytes(hash, &value, sizeof(T)); }
+    static void hashArgument(uint64_t &hash, const char *value) { hashBytes(hash, value, strlen(value)); }
+    static void hashArgument(uint64_t &hash, const std::string &value) { hashBytes(hash, value.data(), value.size()); }
+
+    static Argument *next(Record &record, Argument::Type type)
+    {
+        if (record.argumentCount == maxArguments)
+            return nullptr;
+        Argument *argument = &record.arguments[record.argumentCount++];
+        argument->type = type;
+        return argument;
+    }
+
+    static void packSigned(Record &record, long long value)
+    {
+        if (Argument *argument = next(record, Argument::SIGNED))
+            argument->integer = value;
+    }
+
+    static void packUnsigned(Record &record, unsigned long long value)
+    {
+        if (Argument *argument = next(record, Argument::UNSIGNED))
+            argument->natural = value;
+    }
+
+    static void packText(Record &record, const char *value, size_t length)
+    {
+        Argument *argument = next(record, Argument::TEXT);
+        if (!argument)
+            return;
+        // truncated to what is left of the text storage, the last byte is always a terminator
+        if (record.textUsed >= textSize) {
+            argument->text = textSize - 1;
+            return;
+        }
+        length = std::min(length, (size_t) (textSize - 1 - record.textUsed));
+        memcpy(record.text + record.textUsed, value, length);
+        argument->text = record.textUsed;
+        record.textUsed += (int) length;
+        record.text[record.textUsed++] = '\0';
+    }
+
+    static void packArgument(Record &record, int value) { packSigned(record, value); }
+    static void packArgument(Record &record, long value) { packSigned(record, value); }
+    static void packArgument(Record &record, long long value) { packSigned(record, value); }
+    static void packArgument(Record &record, unsigned int value) { packUnsigned(record, value); }
+    static void packArgument(Record &record, unsigned long value) { packUnsigned(record, value); }
+    static void packArgument(Record &record, unsigned long long value) { packUnsigned(record, value); }
+    static void packArgument(Record &record, const char *value) { packText(record, value, strlen(value)); }
+    static void packArgument(Record &record, const std::string &value) { packText(record, value.data(), value.size()); }
+    static void packArgument(Record &record, char value) { packText(record, &value, 1); }
+
+    static void packArgument(Record &record, double value)
+    {
+        if (Argument *argument = next(record, Argument::REAL))
+            argument->real = value;
+    }
+
+    static void packArgument(Record &record, float value) { packArgument(record, (double) value); }
+
+    static void packArgument(Record &record, bool value)
+    {
+        if (Argument *argument = next(record, Argument::BOOLEAN))
+            argument->integer = value;
+    }
+
+    static void appendArgument(std::string &out, const Record &record, const Argument &argument)
+    {
+        char buffer[64];
+        switch (argument.type) {
+            case Argument::SIGNED: snprintf(buffer, sizeof(buffer), "%lld", argument.integer); break;
+            case Argument::UNSIGNED: snprintf(buffer, sizeof(buffer), "%llu", argument.natural); break;
+            case Argument::REAL: snprintf(buffer, sizeof(buffer), "%g", argument.real); break;
+            case Argument::BOOLEAN: snprintf(buffer, sizeof(buffer), "%s", argument.integer ? "true" : "false"); break;
+            case Argument::TEXT: out += record.text + argument.text; return;
+        }
+        out += buffer;
+    }
+
+    // "{}" in the format is replaced by the next argument
+    static void format(std::string &out, const Record &record)
+    {
+        static const char *levels[] = {"DEBUG", "INFO", "WARNING", "ERROR"};
+        char prefix[48];
+        snprintf(prefix, sizeof(prefix), "[%9.3f] %-7s ", record.time / 1e9, levels[record.site->level]);
+        out += prefix;
+        int argument = 0;
+        for (const char *c = record.site->format; *c; c++) {
+            if (c[0] == '{' && c[1] == '}' && argument < record.argumentCount) {
+                appendArgument(out, record, record.arguments[argument++]);
+                c++;
+            } else {
+                out += *c;
+            }
+        }
+        if (record.repeats > 0)
+            out += " (" + std::to_string(record.repeats) + " repeats suppressed)";
+        out += '\n';
+    }
+
+    // the only consumer, so the dequeue side needs no atomic position
+    void writerLoop()
+    {
+        std::string out;
+        while (true) {
+            bool stopping = quit.load();
+            while (true) {
+                Cell& cell = cells[dequeuePosition % capacity];
+                if (cell.sequence.load(std::memory_order_acquire) != dequeuePosition + 1)
+                    break;
+                format(out, cell.record);
+                cell.sequence.store(dequeuePosition + capacity, std::memory_order_release);
+                dequeuePosition++;
+            }
+            uint32_t lost = dropped.exchange(0, std::memory_order_relaxed);
+            if (lost > 0)
+                out += "log ring full, " + std::to_string(lost) + " messages dropped\n";
+            if (!out.empty()) {
+                fwrite(out.data(), 1, out.size(), stdout);
+                fflush(stdout);
+                out.clear();
+            }
+            if (stopping)
+                return;
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    }
+};
+
+#define LOG_AT(logLevel, logFormat, ...) \
+    do { \
+        static Log::Site logSite("" logFormat "", logLevel); \
+        Log::Write(logSite, ##__VA_ARGS__); \
+    } while (0)
+
+#if LOG_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(format, ...) LOG_AT(LOG_LEVEL_DEBUG, format, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(format, ...) ((void) 0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(format, ...) LOG_AT(LOG_LEVEL_INFO, format, ##__VA_ARGS__)
+#else
+#define LOG_INFO(format, ...) ((void) 0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_WARNING
+#define LOG_WARNING(format, ...) LOG_AT(LOG_LEVEL_WARNING, format, ##__VA_ARGS__)
+#else
+#define LOG_WARNING(format, ...) ((void) 0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_ERROR
+#define LOG_ERROR(format, ...) LOG_AT(LOG_LEVEL_ERROR, format, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(format, ...) ((void) 0)
+#endif
+
+#endif
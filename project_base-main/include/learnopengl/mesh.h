@@ -7,6 +7,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <learnopengl/shader.h>
+#include <learnopengl/textureatlas.h>
 
 #include <string>
 #include <vector>
@@ -31,6 +32,17 @@ struct Texture {
     unsigned int id;
     string type;
     string path;
+    // entry in the mesh's texture atlas, -1 when id is a texture of its own
+    int atlasEntry = -1;
+};
+
+// how a material covers what is behind it, decided when the model is imported. opaque meshes draw with a
+// program without discard and with blending off, so early-Z holds for them; alpha tested ones need the
+// ALPHA_TEST variants and draw after them; blended ones go through the transparent pass
+enum MaterialClass {
+    MATERIAL_OPAQUE,
+    MATERIAL_ALPHA_TESTED,
+    MATERIAL_BLENDED
 };
 
 class Mesh {
@@ -39,15 +51,24 @@ public:
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
+    // tightly packed copy of the vertex positions, used by the depth pre-pass
+    vector<glm::vec3>    positions;
 
     unsigned int VAO;
+    unsigned int depthVAO;
     std::string glslIdentifierPrefix;
+    // where the maps with an atlasEntry live, set by the model
+    const TextureAtlas *atlas = nullptr;
+    MaterialClass materialClass = MATERIAL_OPAQUE;
+    // from the material (MTL d, or 1 - Tr), read by blending.fs as material.opacity
+    float opacity = 1.0f;
     // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, vector<glm::vec3> positions)
     {
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
+        this->positions = positions;
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
         setupMesh();
@@ -61,8 +82,24 @@ public:
         unsigned int specularNr = 1;
         unsigned int normalNr   = 1;
         unsigned int heightNr   = 1;
+        // the material record of the mesh: layer and rect of the packed diffuse and specular maps, layer -1
+        // tells the shader to sample texture_diffuse1 / texture_specular1 instead
+        glm::vec4 diffuseAtlas(-1.0f), specularAtlas(-1.0f);
+        float diffuseLayer = -1.0f, specularLayer = -1.0f;
         for(unsigned int i = 0; i < textures.size(); i++)
         {
+            if (textures[i].atlasEntry >= 0)
+            {
+                const TextureAtlas::Entry &entry = atlas->Get(textures[i].atlasEntry);
+                if (textures[i].type == "texture_diffuse" && diffuseLayer < 0.0f) {
+                    diffuseLayer = entry.layer;
+                    diffuseAtlas = entry.rect;
+                } else if (textures[i].type == "texture_specular" && specularLayer < 0.0f) {
+                    specularLayer = entry.layer;
+                    specularAtlas = entry.rect;
+                }
+                continue;
+            }
             glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
             // retrieve texture number (the N in diffuse_textureN)
             string number;
@@ -81,7 +118,14 @@ public:
             // and finally bind the texture
             glBindTexture(GL_TEXTURE_2D, textures[i].id);
         }
-
+        glUniform1f(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + "diffuseLayer").c_str()), diffuseLayer);
+        glUniform4fv(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + "diffuseRect").c_str()), 1, &diffuseAtlas[0]);
+        glUniform1f(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + "specularLayer").c_str()), specularLayer);
+        glUniform4fv(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + "specularRect").c_str()), 1, &specularAtlas[0]);
+        glUniform1f(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + "opacity").c_str()), opacity);
+        // the same array for every mesh of every model that shares the atlas
+        if (atlas && (diffuseLayer >= 0.0f || specularLayer >= 0.0f))
+            atlas->Bind();
 
 
         // draw mesh
@@ -93,9 +137,19 @@ public:
         glActiveTexture(GL_TEXTURE0);
     }
 
+    // render only the depth of the mesh, reading the position-only stream.
+    // no textures are bound since the depth program doesn't sample anything.
+    void DrawDepth()
+    {
+        glBindVertexArray(depthVAO);
+        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+    }
+
 private:
     // render data
     unsigned int VBO, EBO;
+    unsigned int depthVBO;
 
     // initializes all the buffer objects/arrays
     void setupMesh()
@@ -134,6 +188,21 @@ private:
         glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
 
         glBindVertexArray(0);
+
+        // depth-only stream: 12 bytes per vertex instead of 56, so the pre-pass fetches a fraction
+        // of the vertex data. It shares the element buffer with the full VAO.
+        glGenVertexArrays(1, &depthVAO);
+        glGenBuffers(1, &depthVBO);
+
+        glBindVertexArray(depthVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, depthVBO);
+        glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), &positions[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+
+        glBindVertexArray(0);
     }
 };
 #endif
\ No newline at end of file
@@ -12,6 +12,8 @@
 
 #include <learnopengl/mesh.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/profiler.h>
+#include <learnopengl/log.h>
 
 #include <string>
 #include <fstream>
@@ -33,11 +35,17 @@ public:
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    // model space bounding box of all meshes
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    // small diffuse and specular maps go here instead of into textures of their own, see textureatlas.h
+    TextureAtlas *atlas;
 
     // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    Model(string const &path, bool gamma = false, TextureAtlas *atlas = nullptr) : gammaCorrection(gamma), atlas(atlas)
     {
         loadModel(path);
+        computeBounds();
     }
 
     // draws the model, and thus all its meshes
@@ -47,22 +55,65 @@ public:
             meshes[i].Draw(shader);
     }
 
+    // draws the meshes of one material class
+    void Draw(Shader &shader, MaterialClass materialClass)
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            if (meshes[i].materialClass == materialClass)
+                meshes[i].Draw(shader);
+    }
+
+    // draws only the depth of the meshes of one material class, using their position-only stream. that
+    // stream has no texture coordinates, so it is for MATERIAL_OPAQUE; the cutouts go through Draw with the
+    // ALPHA_TEST depth program
+    void DrawDepth(MaterialClass materialClass)
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            if (meshes[i].materialClass == materialClass)
+                meshes[i].DrawDepth();
+    }
+
     void SetShaderTextureNamePrefix(std::string prefix) {
         for (Mesh& mesh: meshes) {
             mesh.glslIdentifierPrefix = prefix;
         }
     }
+
+    // overrides the opacity of the material of every mesh, below 1 the meshes are drawn blended
+    void SetOpacity(float opacity) {
+        for (Mesh& mesh: meshes) {
+            mesh.opacity = opacity;
+            if (opacity < 1.0f)
+                mesh.materialClass = MATERIAL_BLENDED;
+        }
+    }
 private:
+    // material class of every diffuse map looked at so far, by path
+    map<string, MaterialClass> textureAlphaClasses;
+
+    void computeBounds()
+    {
+        bool first = true;
+        for (const Mesh& mesh: meshes) {
+            for (const glm::vec3& position: mesh.positions) {
+                boundsMin = first ? position : glm::min(boundsMin, position);
+                boundsMax = first ? position : glm::max(boundsMax, position);
+                first = false;
+            }
+        }
+    }
+
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const &path)
     {
+        PROFILE_ZONE("Model::loadModel");
         // read file via ASSIMP
         Assimp::Importer importer;
         const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
-            cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+            LOG_ERROR("ERROR::ASSIMP:: {}", importer.GetErrorString());
             return;
         }
         // retrieve the directory path of the filepath
@@ -70,6 +121,12 @@ private:
 
         // process ASSIMP's root node recursively
         processNode(scene->mRootNode, scene);
+
+        int classCounts[3] = { 0, 0, 0 };
+        for (const Mesh& mesh: meshes)
+            classCounts[mesh.materialClass]++;
+        LOG_INFO("{}: {} opaque, {} alpha tested, {} blended meshes", path, classCounts[MATERIAL_OPAQUE],
+                 classCounts[MATERIAL_ALPHA_TESTED], classCounts[MATERIAL_BLENDED]);
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
@@ -93,10 +150,12 @@ private:
 
     Mesh processMesh(aiMesh *mesh, const aiScene *scene)
     {
+        PROFILE_ZONE("Model::processMesh");
         // data to fill
         vector<Vertex> vertices;
         vector<unsigned int> indices;
         vector<Texture> textures;
+        vector<glm::vec3> positions;
 
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
@@ -108,6 +167,7 @@ private:
             vector.y = mesh->mVertices[i].y;
             vector.z = mesh->mVertices[i].z;
             vertex.Position = vector;
+            positions.push_back(vector);
             // normals
             if (mesh->HasNormals())
             {
@@ -179,7 +239,48 @@ private:
 
 
         // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        Mesh result(vertices, indices, textures, positions);
+        result.atlas = atlas;
+        // the OBJ importer turns both d and Tr (as 1 - Tr) into the opacity
+        material->Get(AI_MATKEY_OPACITY, result.opacity);
+        if (result.opacity < 1.0f)
+            result.materialClass = MATERIAL_BLENDED;
+        else if (!diffuseMaps.empty())
+            result.materialClass = textureAlphaClass(diffuseMaps[0].path);
+        return result;
+    }
+
+    // what the alpha channel of a diffuse map asks for. maps without one are opaque without being read,
+    // the others are loaded once more: mostly 0 or 1 is a cutout, a lot in between needs blending
+    MaterialClass textureAlphaClass(const string &path)
+    {
+        map<string, MaterialClass>::iterator found = textureAlphaClasses.find(path);
+        if (found != textureAlphaClasses.end())
+            return found->second;
+        MaterialClass materialClass = MATERIAL_OPAQUE;
+        string filename = this->directory + '/' + path;
+        int width, height, components;
+        if (stbi_info(filename.c_str(), &width, &height, &components) && (components == 2 || components == 4)) {
+            unsigned char *data = stbi_load(filename.c_str(), &width, &height, &components, 4);
+            if (data) {
+                long long seeThrough = 0, partial = 0, texels = (long long) width * height;
+                for (long long i = 0; i < texels; i++) {
+                    unsigned char alpha = data[i * 4 + 3];
+                    if (alpha < 250)
+                        seeThrough++;
+                    if (alpha > 5 && alpha < 250)
+                        partial++;
+                }
+                stbi_image_free(data);
+                // antialiased edges of a cutout are a thin band, a quarter of the map is not
+                if (partial * 4 > texels)
+                    materialClass = MATERIAL_BLENDED;
+                else if (seeThrough > 0)
+                    materialClass = MATERIAL_ALPHA_TESTED;
+            }
+        }
+        textureAlphaClasses[path] = materialClass;
+        return materialClass;
     }
 
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
@@ -205,7 +306,11 @@ private:
             if(!skip)
             {   // if texture hasn't been loaded already, load it
                 Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
+                texture.id = 0;
+                if (atlas && (typeName == "texture_diffuse" || typeName == "texture_specular"))
+                    texture.atlasEntry = atlas->AddFile(this->directory + '/' + str.C_Str());
+                if (texture.atlasEntry < 0)
+                    texture.id = TextureFromFile(str.C_Str(), this->directory);
                 texture.type = typeName;
                 texture.path = str.C_Str();
                 textures.push_back(texture);
@@ -219,6 +324,7 @@ private:
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
 {
+    PROFILE_ZONE("TextureFromFile");
     string filename = string(path);
     filename = directory + '/' + filename;
 
@@ -250,7 +356,7 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
     }
     else
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
+        LOG_ERROR("Texture failed to load at path: {}", filename);
         stbi_image_free(data);
     }
 
@@ -0,0 +1,170 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+// scoped CPU profiling zones, written out as a Chrome / Perfetto trace (chrome://tracing, ui.perfetto.dev).
+//
+//   PROFILE_ZONE("Model::loadModel");    // times the rest of the enclosing scope
+//   PROFILE_THREAD_NAME("main");
+//   PROFILE_WRITE_TRACE("profile_trace.json");
+//
+// zone names have to be string literals, only the pointer is stored. every thread appends its zones to
+// its own buffer, the owning thread is the only writer so recording takes no lock: the event is filled
+// in and then published with a release store of the count. the buffer grows in fixed chunks that are
+// never moved, so the exporter can read it concurrently. timestamps are steady_clock nanoseconds.
+// a thread records at most chunkSize * maxChunks zones, later ones are counted and dropped.
+// the whole thing compiles to nothing unless ENABLE_PROFILER is defined (CMake option ENABLE_PROFILER, off by
+// default so release builds neither record nor write the trace).
+
+#ifdef ENABLE_PROFILER
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+#include <learnopengl/log.h>
+
+class Profiler
+{
+public:
+    struct Event {
+        const char *name;
+        uint64_t start;
+        uint64_t end;
+    };
+
+    static const uint32_t chunkSize = 4096;
+    static const uint32_t maxChunks = 1024;
+
+    struct ThreadBuffer {
+        const char *name = nullptr;
+        uint32_t id = 0;
+        std::atomic<uint32_t> count{0};
+        std::atomic<uint32_t> dropped{0};
+        Event *chunks[maxChunks] = {};
+
+        void Push(const char *zoneName, uint64_t start, uint64_t end)
+        {
+            uint32_t index = count.load(std::memory_order_relaxed);
+            uint32_t chunk = index / chunkSize;
+            if (chunk >= maxChunks) {
+                if (dropped.fetch_add(1, std::memory_order_relaxed) == 0)
+                    LOG_WARNING("profiler: buffer of thread {} is full, its zones are dropped from here on", id);
+                return;
+            }
+            if (chunks[chunk] == nullptr)
+                chunks[chunk] = new Event[chunkSize];
+            Event& event = chunks[chunk][index % chunkSize];
+            event.name = zoneName;
+            event.start = start;
+            event.end = end;
+            count.store(index + 1, std::memory_order_release);
+        }
+    };
+
+    static uint64_t Now()
+    {
+        return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - epoch()).count();
+    }
+
+    // the calling thread's buffer, registered on first use. only this registration takes a lock.
+    static ThreadBuffer &Buffer()
+    {
+        thread_local ThreadBuffer *buffer = nullptr;
+        if (buffer == nullptr) {
+            buffer = new ThreadBuffer();
+            std::lock_guard<std::mutex> lock(registryMutex());
+            buffer->id = (uint32_t) registry().size() + 1;
+            registry().push_back(buffer);
+        }
+        return *buffer;
+    }
+
+    static bool WriteChromeTrace(const char *path)
+    {
+        std::ofstream file(path);
+        if (!file)
+            return false;
+        std::lock_guard<std::mutex> lock(registryMutex());
+        file << "{\"traceEvents\":[\n";
+        bool first = true;
+        for (ThreadBuffer *buffer : registry()) {
+            if (buffer->name) {
+                file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->id
+                     << ",\"args\":{\"name\":\"" << buffer->name << "\"}}";
+                first = false;
+            }
+            uint32_t count = buffer->count.load(std::memory_order_acquire);
+            for (uint32_t i = 0; i < count; i++) {
+                const Event& event = buffer->chunks[i / chunkSize][i % chunkSize];
+                // chrome wants microseconds, fractions keep the nanosecond resolution
+                file << (first ? "" : ",\n") << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->id
+                     << ",\"ts\":" << event.start / 1000 << '.' << event.start % 1000 / 100 << event.start % 100 / 10 << event.start % 10
+                     << ",\"dur\":" << (event.end - event.start) / 1000.0 << '}';
+                first = false;
+            }
+        }
+        file << "\n]}\n";
+        for (ThreadBuffer *buffer : registry()) {
+            uint32_t dropped = buffer->dropped.load(std::memory_order_relaxed);
+            if (dropped > 0)
+                LOG_WARNING("profiler: {} zones of thread {} didn't fit the buffer and are missing from {}", dropped, buffer->id, path);
+        }
+        return true;
+    }
+
+private:
+    static std::chrono::steady_clock::time_point epoch()
+    {
+        static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        return start;
+    }
+
+    static std::vector<ThreadBuffer *> &registry()
+    {
+        static std::vector<ThreadBuffer *> buffers;
+        return buffers;
+    }
+
+    static std::mutex &registryMutex()
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
+};
+
+class ProfileZone
+{
+public:
+    explicit ProfileZone(const char *name) : name(name), start(Profiler::Now())
+    {
+    }
+
+    ~ProfileZone()
+    {
+        Profiler::Buffer().Push(name, start, Profiler::Now());
+    }
+
+private:
+    const char *name;
+    uint64_t start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+// "" name "" only compiles for string literals
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)("" name "")
+#define PROFILE_THREAD_NAME(threadName) (Profiler::Buffer().name = "" threadName "")
+#define PROFILE_WRITE_TRACE(path) Profiler::WriteChromeTrace(path)
+
+#else
+
+#define PROFILE_ZONE(name) ((void) 0)
+#define PROFILE_THREAD_NAME(name) ((void) 0)
+#define PROFILE_WRITE_TRACE(path) ((void) 0)
+
+#endif
+#endif
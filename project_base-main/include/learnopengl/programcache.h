@@ -0,0 +1,167 @@
+#ifndef PROGRAMCACHE_H
+#define PROGRAMCACHE_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/log.h>
+
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+// GL 4.1 / ARB_get_program_binary, not part of the 3.3 glad loader
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+// linked program binaries kept on disk between launches.
+// a program is keyed by a hash of its sources and the vendor, renderer and version strings of the driver,
+// so a driver update or an edited shader just misses. a hit restores the program with glProgramBinary
+// and skips the driver's compiler; when the driver rejects the binary the caller compiles from source as
+// if the cache wasn't there. the entry points are looked up through the same loader as glad, a context
+// without them (or without a single binary format) leaves the cache disabled.
+class ProgramBinaryCache
+{
+public:
+    int hits = 0;
+    int misses = 0;
+
+    static ProgramBinaryCache &Instance()
+    {
+        static ProgramBinaryCache cache;
+        return cache;
+    }
+
+    // after gladLoadGLLoader, with the same loader
+    void Init(GLADloadproc loader, const std::string &cacheDirectory)
+    {
+        directory = cacheDirectory;
+        getProgramBinary = (GetProgramBinaryProc) loader("glGetProgramBinary");
+        programBinary = (ProgramBinaryProc) loader("glProgramBinary");
+        programParameteri = (ProgramParameteriProc) loader("glProgramParameteri");
+        GLint formats = 0;
+        if (getProgramBinary && programBinary && programParameteri)
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        // a context without the extension reports an error for the unknown enum
+        while (glGetError() != GL_NO_ERROR);
+        enabled = formats > 0;
+        if (!enabled) {
+            LOG_INFO("program binaries not supported, shaders are compiled from source");
+            return;
+        }
+        mkdir(directory.c_str(), 0755);
+        driverHash = hashString(14695981039346656037ull, (const char *) glGetString(GL_VENDOR));
+        driverHash = hashString(driverHash, (const char *) glGetString(GL_RENDERER));
+        driverHash = hashString(driverHash, (const char *) glGetString(GL_VERSION));
+    }
+
+    bool Enabled() const { return enabled; }
+
+    uint64_t Key(const std::string &vertexCode, const std::string &fragmentCode, const std::string &geometryCode) const
+    {
+        uint64_t key = hashString(driverHash, vertexCode.c_str());
+        // separators, so moving text from one stage to the next changes the key
+        key = hashString(key, "\x01");
+        key = hashString(key, fragmentCode.c_str());
+        key = hashString(key, "\x01");
+        return hashString(key, geometryCode.c_str());
+    }
+
+    // restores the program from the cache, false when there is nothing usable for the key
+    bool Load(unsigned int program, uint64_t key)
+    {
+        if (!enabled)
+            return false;
+        std::ifstream file(path(key), std::ios::binary);
+        GLenum format = 0;
+        GLint length = 0;
+        if (!file.read((char *) &format, sizeof(format)) || !file.read((char *) &length, sizeof(length)) || length <= 0) {
+            misses++;
+            return false;
+        }
+        std::vector<char> binary(length);
+        if (!file.read(&binary[0], length)) {
+            misses++;
+            return false;
+        }
+        programBinary(program, format, &binary[0], length);
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        // a binary from another driver build may be rejected even with matching strings
+        while (glGetError() != GL_NO_ERROR);
+        if (!linked) {
+            misses++;
+            return false;
+        }
+        hits++;
+        return true;
+    }
+
+    // before glLinkProgram, otherwise the driver may not keep the binary around
+    void PrepareLink(unsigned int program)
+    {
+        if (enabled)
+            programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // after a successful link
+    void Store(unsigned int program, uint64_t key)
+    {
+        if (!enabled)
+            return;
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        GLsizei written = 0;
+        getProgramBinary(program, length, &written, &format, &binary[0]);
+        if (written <= 0)
+            return;
+        std::ofstream file(path(key), std::ios::binary);
+        file.write((const char *) &format, sizeof(format));
+        file.write((const char *) &written, sizeof(written));
+        file.write(&binary[0], written);
+    }
+
+private:
+    typedef void (APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+    typedef void (APIENTRYP ProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+    typedef void (APIENTRYP ProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+
+    GetProgramBinaryProc getProgramBinary = nullptr;
+    ProgramBinaryProc programBinary = nullptr;
+    ProgramParameteriProc programParameteri = nullptr;
+    bool enabled = false;
+    std::string directory;
+    uint64_t driverHash = 0;
+
+    static uint64_t hashString(uint64_t hash, const char *text)
+    {
+        if (!text)
+            return hash;
+        for (; *text; text++)
+            hash = (hash ^ (unsigned char) *text) * 1099511628211ull;
+        return hash;
+    }
+
+    std::string path(uint64_t key) const
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long) key);
+        return directory + name;
+    }
+};
+#endif
@@ -0,0 +1,224 @@
+#ifndef RENDERTARGETS_H
+#define RENDERTARGETS_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/log.h>
+
+#include <vector>
+#include <iostream>
+using namespace std;
+
+// format policy for every render target in the frame:
+//   HDR color   - GL_R11F_G11F_B10F, 4 bytes instead of 8 for RGBA16F, the scene never needs alpha
+//   depth       - GL_DEPTH_COMPONENT24 by default or GL_DEPTH_COMPONENT32F, chosen once for the scene
+//                 and the G-buffer so depth can be blitted between them
+//   OIT         - GL_RGBA16F accumulation (weighted color sum, revealage in alpha) and GL_R16F weight sum,
+//                 additive blending of many weighted fragments needs more than 11 bits
+struct TargetFormat {
+    GLenum internalFormat;
+    GLenum format;
+    GLenum type;
+};
+
+const TargetFormat HDR_COLOR_FORMAT = { GL_R11F_G11F_B10F, GL_RGB, GL_FLOAT };
+const TargetFormat DEPTH24_FORMAT = { GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT };
+const TargetFormat DEPTH32F_FORMAT = { GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT };
+const TargetFormat OIT_ACCUMULATION_FORMAT = { GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT };
+const TargetFormat OIT_WEIGHT_FORMAT = { GL_R16F, GL_RED, GL_HALF_FLOAT };
+
+// creates a linearly filtered, edge clamped 2D texture
+unsigned int CreateTargetTexture(int width, int height, const TargetFormat &format)
+{
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, format.internalFormat, width, height, 0, format.format, format.type, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+// textures that only live for part of a frame (bloom mips and the like) are borrowed from here and
+// given back when the pass that reads them is done. free textures are matched by size and format,
+// so the same ones are handed out every frame. textures nobody asked for in a while, e.g. the old
+// sizes after a resize, are deleted in EndFrame.
+class RenderTargetPool
+{
+public:
+    // frames a free texture is kept around without being acquired
+    int maxUnusedFrames = 8;
+
+    unsigned int Acquire(int width, int height, const TargetFormat &format)
+    {
+        for (Entry& entry : entries) {
+            if (!entry.inUse && entry.width == width && entry.height == height && entry.internalFormat == format.internalFormat) {
+                entry.inUse = true;
+                entry.lastUsedFrame = frame;
+                return entry.texture;
+            }
+        }
+        Entry entry;
+        entry.texture = CreateTargetTexture(width, height, format);
+        entry.width = width;
+        entry.height = height;
+        entry.internalFormat = format.internalFormat;
+        entry.inUse = true;
+        entry.lastUsedFrame = frame;
+        entries.push_back(entry);
+        return entry.texture;
+    }
+
+    void Release(unsigned int texture)
+    {
+        for (Entry& entry : entries) {
+            if (entry.texture == texture) {
+                entry.inUse = false;
+                return;
+            }
+        }
+    }
+
+    void EndFrame()
+    {
+        for (size_t i = 0; i < entries.size();) {
+            if (!entries[i].inUse && frame - entries[i].lastUsedFrame > maxUnusedFrames) {
+                glDeleteTextures(1, &entries[i].texture);
+                entries[i] = entries.back();
+                entries.pop_back();
+            } else {
+                i++;
+            }
+        }
+        frame++;
+    }
+
+    void Clear()
+    {
+        for (const Entry& entry : entries)
+            glDeleteTextures(1, &entry.texture);
+        entries.clear();
+    }
+
+    int Size() const { return (int) entries.size(); }
+
+private:
+    struct Entry {
+        unsigned int texture;
+        int width;
+        int height;
+        GLenum internalFormat;
+        bool inUse;
+        long lastUsedFrame;
+    };
+    vector<Entry> entries;
+    long frame = 0;
+};
+
+// the HDR scene framebuffer, sized to the window framebuffer. Resize only records the new size, the
+// attachments are recreated by Update at the start of the next frame, so a window being dragged
+// doesn't reallocate on every callback.
+class RenderTargets
+{
+public:
+    TargetFormat depthFormat;
+    int width = 0;
+    int height = 0;
+
+    // color (0) and bright pass (1) attachments, depth is a renderbuffer
+    unsigned int sceneFBO = 0;
+    unsigned int sceneColor[2] = { 0, 0 };
+    unsigned int sceneDepth = 0;
+    // weighted blended order independent transparency, accumulation (0) and weight (1) attachments over
+    // the scene's depth, resolved into the scene color
+    unsigned int transparencyFBO = 0;
+    unsigned int transparencyAccumulation = 0;
+    unsigned int transparencyWeight = 0;
+
+    RenderTargetPool pool;
+
+    RenderTargets(const TargetFormat &depthFormat = DEPTH24_FORMAT) : depthFormat(depthFormat)
+    {
+    }
+
+    void Resize(int newWidth, int newHeight)
+    {
+        // minimized windows report 0x0, keep the old targets
+        if (newWidth <= 0 || newHeight <= 0)
+            return;
+        pendingWidth = newWidth;
+        pendingHeight = newHeight;
+    }
+
+    // recreates the attachments if the size changed since the last call, returns true in that case
+    bool Update()
+    {
+        if (pendingWidth == width && pendingHeight == height)
+            return false;
+        destroy();
+        width = pendingWidth;
+        height = pendingHeight;
+        create();
+        return true;
+    }
+
+    float Aspect() const { return (float) width / (float) height; }
+
+    void Destroy()
+    {
+        destroy();
+        pool.Clear();
+    }
+
+private:
+    int pendingWidth = 0;
+    int pendingHeight = 0;
+
+    void create()
+    {
+        glGenFramebuffers(1, &sceneFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+        for (unsigned int i = 0; i < 2; i++) {
+            sceneColor[i] = CreateTargetTexture(width, height, HDR_COLOR_FORMAT);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, sceneColor[i], 0);
+        }
+        glGenRenderbuffers(1, &sceneDepth);
+        glBindRenderbuffer(GL_RENDERBUFFER, sceneDepth);
+        glRenderbufferStorage(GL_RENDERBUFFER, depthFormat.internalFormat, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, sceneDepth);
+        unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, attachments);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            LOG_ERROR("Framebuffer not complete!");
+
+        glGenFramebuffers(1, &transparencyFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, transparencyFBO);
+        transparencyAccumulation = CreateTargetTexture(width, height, OIT_ACCUMULATION_FORMAT);
+        transparencyWeight = CreateTargetTexture(width, height, OIT_WEIGHT_FORMAT);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, transparencyAccumulation, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, transparencyWeight, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, sceneDepth);
+        glDrawBuffers(2, attachments);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            LOG_ERROR("Transparency framebuffer not complete!");
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void destroy()
+    {
+        if (sceneFBO == 0)
+            return;
+        glDeleteTextures(2, sceneColor);
+        glDeleteRenderbuffers(1, &sceneDepth);
+        glDeleteFramebuffers(1, &sceneFBO);
+        sceneFBO = sceneColor[0] = sceneColor[1] = sceneDepth = 0;
+        glDeleteTextures(1, &transparencyAccumulation);
+        glDeleteTextures(1, &transparencyWeight);
+        glDeleteFramebuffers(1, &transparencyFBO);
+        transparencyFBO = transparencyAccumulation = transparencyWeight = 0;
+    }
+};
+#endif
@@ -0,0 +1,82 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/model.h>
+
+#include <algorithm>
+#include <cmath>
+
+// a model placed in the world together with its model matrix
+struct SceneObject {
+    Model *model;
+    glm::mat4 transform;
+    // static objects never move after placement, their shadows are cached
+    bool isStatic;
+    // world space bounding box
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    // cell of the HLOD grid the object is merged into, -1 when it is always drawn itself, see hlod.h
+    int hlodCell = -1;
+};
+
+// transforms a box and returns the axis aligned box around the result
+void TransformBounds(const glm::mat4 &transform, const glm::vec3 &localMin, const glm::vec3 &localMax, glm::vec3 &outMin, glm::vec3 &outMax)
+{
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 corner(i & 1 ? localMax.x : localMin.x, i & 2 ? localMax.y : localMin.y, i & 4 ? localMax.z : localMin.z);
+        glm::vec3 world = glm::vec3(transform * glm::vec4(corner, 1.0f));
+        outMin = i == 0 ? world : glm::min(outMin, world);
+        outMax = i == 0 ? world : glm::max(outMax, world);
+    }
+}
+
+SceneObject MakeSceneObject(Model *model, const glm::mat4 &transform, bool isStatic = true)
+{
+    SceneObject object;
+    object.model = model;
+    object.transform = transform;
+    object.isStatic = isStatic;
+    TransformBounds(transform, model->boundsMin, model->boundsMax, object.boundsMin, object.boundsMax);
+    return object;
+}
+
+// the six planes of projection * view, pointing inwards (Gribb and Hartmann)
+struct Frustum {
+    glm::vec4 planes[6];
+
+    explicit Frustum(const glm::mat4 &viewProjection)
+    {
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 4; j++) {
+                planes[i * 2][j] = viewProjection[j][3] + viewProjection[j][i];
+                planes[i * 2 + 1][j] = viewProjection[j][3] - viewProjection[j][i];
+            }
+        }
+    }
+
+    // false only when the box is entirely outside one of the planes
+    bool Intersects(const glm::vec3 &boxMin, const glm::vec3 &boxMax) const
+    {
+        for (const glm::vec4& plane : planes) {
+            // the corner furthest along the plane normal
+            float x = plane.x > 0.0f ? boxMax.x : boxMin.x;
+            float y = plane.y > 0.0f ? boxMax.y : boxMin.y;
+            float z = plane.z > 0.0f ? boxMax.z : boxMin.z;
+            if (plane.x * x + plane.y * y + plane.z * z + plane.w < 0.0f)
+                return false;
+        }
+        return true;
+    }
+};
+
+// distance from a point to the closest point of a box, 0 inside
+float DistanceToBox(const glm::vec3 &point, const glm::vec3 &boxMin, const glm::vec3 &boxMax)
+{
+    float dx = std::max(std::max(boxMin.x - point.x, 0.0f), point.x - boxMax.x);
+    float dy = std::max(std::max(boxMin.y - point.y, 0.0f), point.y - boxMax.y);
+    float dz = std::max(std::max(boxMin.z - point.z, 0.0f), point.z - boxMax.z);
+    return std::sqrt(dx * dx + dy * dy + dz * dz);
+}
+#endif
@@ -9,61 +9,63 @@
 #include <sstream>
 #include <iostream>
 #include <common.h>
+#include <learnopengl/profiler.h>
+#include <learnopengl/log.h>
+#include <learnopengl/programcache.h>
+
+#include <initializer_list>
+#include <algorithm>
+#include <vector>
+#include <thread>
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// shaders are built in two steps. the constructor only submits the compiles and the link, so the driver
+// can work on all programs at once (on its own threads with GL_KHR_parallel_shader_compile) while models
+// and textures load. Finish checks the results, it is called by FinishAll before the render loop or at the
+// latest by the first use(). Ready tells without blocking whether Finish would have to wait.
 class Shader
 {
 public:
     unsigned int ID;
-    // constructor generates the shader on the fly
+    // constructor submits the shader build, the status is checked by Finish. defines ("#define BLOOM\n...")
+    // go right after the #version line of every stage, see ShaderVariants
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr,
+           const std::string &defines = "")
     {
-        std::string vertexPathString(vertexPath);
-        std::string fragmentPathString(fragmentPath);
-
-        vertexPath = vertexPathString.c_str();
-        fragmentPath= fragmentPathString.c_str();
+        PROFILE_ZONE("Shader::Shader");
         // 1. retrieve the vertex/fragment source code from filePath
         std::string vertexCode;
         std::string fragmentCode;
         std::string geometryCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
         try 
         {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();		
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();			
+            vertexCode = injectIncludes(readFile(vertexPath), vertexPath);
+            fragmentCode = injectIncludes(readFile(fragmentPath), fragmentPath);
             // if geometry shader path is present, also load a geometry shader
             if(geometryPath != nullptr)
-            {
-                std::string geometryPathString(geometryPath);
-                geometryPath = geometryPathString.c_str();
-                gShaderFile.open(geometryPath);
-                std::stringstream gShaderStream;
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
-            }
+                geometryCode = injectIncludes(readFile(geometryPath), geometryPath);
         }
         catch (std::ifstream::failure& e)
         {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+            LOG_ERROR("ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ");
+        }
+        if (!defines.empty()) {
+            vertexCode = injectDefines(vertexCode, defines);
+            fragmentCode = injectDefines(fragmentCode, defines);
+            if (geometryPath != nullptr)
+                geometryCode = injectDefines(geometryCode, defines);
         }
+        // a program linked on an earlier launch with the same sources and driver skips the compiler
+        ProgramBinaryCache &cache = ProgramBinaryCache::Instance();
+        cacheKey = cache.Key(vertexCode, fragmentCode, geometryCode);
+        ID = glCreateProgram();
+        if (cache.Load(ID, cacheKey))
+            return;
+        pending = true;
         const char* vShaderCode = vertexCode.c_str();
         const char * fShaderCode = fragmentCode.c_str();
         // 2. compile shaders
@@ -72,41 +74,109 @@ public:
         vertex = glCreateShader(GL_VERTEX_SHADER);
         glShaderSource(vertex, 1, &vShaderCode, NULL);
         glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
         // fragment Shader
         fragment = glCreateShader(GL_FRAGMENT_SHADER);
         glShaderSource(fragment, 1, &fShaderCode, NULL);
         glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
         // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
+        unsigned int geometry = 0;
         if(geometryPath != nullptr)
         {
             const char * gShaderCode = geometryCode.c_str();
             geometry = glCreateShader(GL_GEOMETRY_SHADER);
             glShaderSource(geometry, 1, &gShaderCode, NULL);
             glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
         }
-        // shader Program
-        ID = glCreateProgram();
+        // shader Program, linked without waiting for the compiles, a failed one fails the link
         glAttachShader(ID, vertex);
         glAttachShader(ID, fragment);
         if(geometryPath != nullptr)
             glAttachShader(ID, geometry);
+        cache.PrepareLink(ID);
         glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
+        stages[0] = vertex;
+        stages[1] = fragment;
+        stages[2] = geometry;
+    }
+
+    // true when the build is done and Finish won't block. without the parallel compile extension there
+    // is no way to ask, and the answer is always true.
+    bool Ready() const
+    {
+        if (!pending || !parallelCompile())
+            return true;
+        GLint done = GL_FALSE;
+        glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &done);
+        return done == GL_TRUE;
+    }
+
+    // checks the compiles and the link, logs errors and caches the binary of a successful link
+    void Finish()
+    {
+        if (!pending)
+            return;
+        pending = false;
+        checkCompileErrors(stages[0], "VERTEX");
+        checkCompileErrors(stages[1], "FRAGMENT");
+        if (stages[2])
+            checkCompileErrors(stages[2], "GEOMETRY");
+        if (checkCompileErrors(ID, "PROGRAM"))
+            ProgramBinaryCache::Instance().Store(ID, cacheKey);
         // delete the shaders as they're linked into our program now and no longer necessery
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if(geometryPath != nullptr)
-            glDeleteShader(geometry);
+        for (unsigned int stage : stages)
+            if (stage)
+                glDeleteShader(stage);
+    }
 
+    // finishes the shaders in the order the driver completes them
+    static void FinishAll(std::initializer_list<Shader *> shaders)
+    {
+        PROFILE_ZONE("Shader::FinishAll");
+        std::vector<Shader *> remaining(shaders);
+        while (!remaining.empty()) {
+            bool progressed = false;
+            for (size_t i = 0; i < remaining.size();) {
+                if (remaining[i]->Ready()) {
+                    remaining[i]->Finish();
+                    remaining.erase(remaining.begin() + i);
+                    progressed = true;
+                } else {
+                    i++;
+                }
+            }
+            if (!progressed)
+                std::this_thread::yield();
+        }
+    }
+
+    // lets the driver compile on as many threads as it likes, once after the GL functions are loaded
+    static void EnableParallelCompile(GLADloadproc loader)
+    {
+        typedef void (APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+        GLint extensionCount = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+        for (GLint i = 0; i < extensionCount; i++) {
+            std::string extension = (const char *) glGetStringi(GL_EXTENSIONS, i);
+            const char *function = nullptr;
+            if (extension == "GL_KHR_parallel_shader_compile")
+                function = "glMaxShaderCompilerThreadsKHR";
+            else if (extension == "GL_ARB_parallel_shader_compile")
+                function = "glMaxShaderCompilerThreadsARB";
+            if (!function)
+                continue;
+            MaxShaderCompilerThreadsProc maxThreads = (MaxShaderCompilerThreadsProc) loader(function);
+            if (maxThreads)
+                maxThreads(0xFFFFFFFF);
+            parallelCompile() = true;
+        }
+        LOG_INFO("parallel shader compile {}", parallelCompile() ? "on" : "not supported");
     }
     // activate the shader
     // ------------------------------------------------------------------------
     void use() 
     { 
+        if (pending)
+            Finish();
         glUseProgram(ID); 
     }
     // utility uniform functions
@@ -169,9 +239,67 @@ public:
     }
 
 private:
+    bool pending = false;
+    unsigned int stages[3] = {0, 0, 0};
+    uint64_t cacheKey = 0;
+
+    static bool &parallelCompile()
+    {
+        static bool supported = false;
+        return supported;
+    }
+
+    // whole file in one read, sized up front
+    static std::string readFile(const char* path)
+    {
+        std::ifstream file;
+        file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        file.open(path, std::ios::binary | std::ios::ate);
+        std::string code((size_t) file.tellg(), '\0');
+        file.seekg(0);
+        if (!code.empty())
+            file.read(&code[0], code.size());
+        return code;
+    }
+
+    // replaces the '#include "name"' lines with the file next to the including one, for code that several
+    // shaders share. one level deep. the snippet is source string 1 in compile errors, #line puts the
+    // numbers after it back on the including file
+    static std::string injectIncludes(const std::string &code, const char *path)
+    {
+        std::string directory(path);
+        size_t slash = directory.find_last_of('/');
+        directory = slash == std::string::npos ? "" : directory.substr(0, slash + 1);
+        std::string result;
+        int line = 1;
+        for (size_t lineStart = 0; lineStart < code.size(); line++) {
+            size_t lineEnd = std::min(code.find('\n', lineStart), code.size());
+            std::string text = code.substr(lineStart, lineEnd - lineStart);
+            size_t open = text.find('"'), close = open == std::string::npos ? open : text.find('"', open + 1);
+            if (text.compare(0, 8, "#include") == 0 && close != std::string::npos)
+                result += "#line 1 1\n" + readFile((directory + text.substr(open + 1, close - open - 1)).c_str()) +
+                          "\n#line " + std::to_string(line + 1) + " 0\n";
+            else
+                result += text + "\n";
+            lineStart = lineEnd + 1;
+        }
+        return result;
+    }
+
+    // #version has to stay the first line. #line puts the line numbers in compile errors back on the file
+    static std::string injectDefines(const std::string &code, const std::string &defines)
+    {
+        size_t version = code.find("#version");
+        size_t lineEnd = version == std::string::npos ? std::string::npos : code.find('\n', version);
+        if (lineEnd == std::string::npos)
+            return defines + code;
+        int line = 2 + (int) std::count(code.begin(), code.begin() + lineEnd, '\n');
+        return code.substr(0, lineEnd + 1) + defines + "#line " + std::to_string(line) + "\n" + code.substr(lineEnd + 1);
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type)
+    bool checkCompileErrors(GLuint shader, std::string type)
     {
         GLint success;
         GLchar infoLog[1024];
@@ -181,7 +309,7 @@ private:
             if(!success)
             {
                 glGetShaderInfoLog(shader, 1024, NULL, infoLog);
-                std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+                LOG_ERROR("ERROR::SHADER_COMPILATION_ERROR of type: {}\n{}\n -- --------------------------------------------------- -- ", type, infoLog);
             }
         }
         else
@@ -190,9 +318,10 @@ private:
             if(!success)
             {
                 glGetProgramInfoLog(shader, 1024, NULL, infoLog);
-                std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+                LOG_ERROR("ERROR::PROGRAM_LINKING_ERROR of type: {}\n{}\n -- --------------------------------------------------- -- ", type, infoLog);
             }
         }
+        return success;
     }
 };
 #endif
@@ -0,0 +1,93 @@
+#ifndef SHADERVARIANTS_H
+#define SHADERVARIANTS_H
+
+#include <learnopengl/shader.h>
+#include <learnopengl/log.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <functional>
+#include <initializer_list>
+using namespace std;
+
+// one shader source compiled once per combination of feature toggles. bit i of a mask turns on
+// "#define <features[i]>", so the fragment shader picks its code path with #ifdef instead of branching on
+// a uniform for every pixel. variants are built the first time a mask is asked for and kept for the rest of
+// the run; on disk they end up in the program binary cache like any other shader, so a toggle pressed once
+// doesn't compile again on the next launch.
+class ShaderVariants
+{
+public:
+    // setup runs once per variant, with the program bound, for uniforms that never change (sampler units)
+    ShaderVariants(const char *vertexPath, const char *fragmentPath, initializer_list<const char *> features,
+                   function<void(Shader &)> setup = nullptr)
+        : vertexPath(vertexPath), fragmentPath(fragmentPath), features(features.begin(), features.end()), setup(setup)
+    {
+    }
+
+    // mask from the CPU side flags, in the same order as the features
+    static unsigned int Mask(initializer_list<bool> flags)
+    {
+        unsigned int mask = 0, bit = 1;
+        for (bool flag : flags) {
+            if (flag)
+                mask |= bit;
+            bit <<= 1;
+        }
+        return mask;
+    }
+
+    // submits the build of a variant without waiting for it, for Shader::FinishAll
+    Shader &Submit(unsigned int mask)
+    {
+        Variant &variant = variants[mask];
+        if (!variant.shader) {
+            variant.shader.reset(new Shader(vertexPath.c_str(), fragmentPath.c_str(), nullptr, defines(mask)));
+            LOG_DEBUG("{} variant {} submitted", fragmentPath, mask);
+        }
+        return *variant.shader;
+    }
+
+    // the variant for mask, built on the spot when it's new. only the first call for a variant changes
+    // the bound program
+    Shader &Get(unsigned int mask)
+    {
+        Shader &shader = Submit(mask);
+        Variant &variant = variants[mask];
+        if (!variant.configured) {
+            variant.configured = true;
+            shader.Finish();
+            if (setup) {
+                shader.use();
+                setup(shader);
+            }
+        }
+        return shader;
+    }
+
+    size_t Count() const { return variants.size(); }
+
+private:
+    struct Variant {
+        unique_ptr<Shader> shader;
+        bool configured = false;
+    };
+
+    string vertexPath;
+    string fragmentPath;
+    vector<string> features;
+    function<void(Shader &)> setup;
+    map<unsigned int, Variant> variants;
+
+    string defines(unsigned int mask) const
+    {
+        string text;
+        for (size_t i = 0; i < features.size(); i++)
+            if (mask & (1u << i))
+                text += "#define " + features[i] + "\n";
+        return text;
+    }
+};
+#endif
@@ -0,0 +1,242 @@
+#ifndef SHADOWS_H
+#define SHADOWS_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/shader.h>
+#include <learnopengl/log.h>
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+// cascaded shadow maps for the sun.
+// every cascade keeps two depth layers: a cached one with only the static casters, re-rendered when the
+// sun turns past angleThreshold or the cascade's light space box moves, and the per frame one that
+// starts as a copy of the cache and gets the dynamic casters drawn on top.
+// a cascade's box has a fixed size, the bounding sphere of its frustum slice plus recenterMargin, so turning
+// the camera doesn't resize it. it stays put while the sphere is inside it and is re-centered on whole
+// shadow texels when the sphere leaves, so walking around invalidates the cache only every few meters.
+// the sun moves about 19 degrees a second, angleThreshold of 4 degrees keeps the cache for ~12 frames.
+class CascadedShadowMap
+{
+public:
+    static const int cascadeCount = 3;
+
+    int resolution;
+    float shadowDistance;
+    float angleThreshold;
+    // how far the slice's bounding sphere can move inside the box, as a fraction of its radius
+    float recenterMargin = 0.5f;
+
+    // sampled with sampler2DArrayShadow, one layer per cascade
+    unsigned int depthArray = 0;
+    glm::mat4 lightSpaceMatrices[cascadeCount];
+    // far view space depth of each cascade
+    float cascadeSplits[cascadeCount];
+    // how many cascades had their static cache re-rendered during the last frame
+    int staticRedraws = 0;
+
+    CascadedShadowMap(int resolution = 2048, float shadowDistance = 40.0f, float angleThresholdDegrees = 4.0f)
+            : resolution(resolution), shadowDistance(shadowDistance), angleThreshold(glm::radians(angleThresholdDegrees))
+    {
+        depthArray = createArray();
+        staticArray = createArray();
+        glGenFramebuffers(1, &FBO);
+        glGenFramebuffers(1, &staticFBO);
+        // depth only framebuffers
+        unsigned int framebuffers[2] = { FBO, staticFBO };
+        for (unsigned int framebuffer : framebuffers) {
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        for (int i = 0; i < cascadeCount; i++) {
+            staticDirty[i] = true;
+            lightSpaceMatrices[i] = glm::mat4(1.0f);
+            cascadeSplits[i] = shadowDistance;
+        }
+    }
+
+    // quantizes the sun direction and fits the cascades to the current camera frustum.
+    // sceneMin/sceneMax bound every shadow caster and fix the depth range of all cascades.
+    void Update(const glm::vec3 &sunDirection, const glm::mat4 &view, float fovy, float aspect, float zNear,
+                const glm::vec3 &sceneMin, const glm::vec3 &sceneMax)
+    {
+        staticRedraws = 0;
+        glm::vec3 direction = glm::normalize(sunDirection);
+        if (!hasDirection || std::acos(glm::clamp(glm::dot(direction, cachedDirection), -1.0f, 1.0f)) > angleThreshold) {
+            cachedDirection = direction;
+            hasDirection = true;
+            directionChanged = true;
+            for (int i = 0; i < cascadeCount; i++)
+                staticDirty[i] = true;
+        }
+
+        glm::vec3 sceneCenter = 0.5f * (sceneMin + sceneMax);
+        float sceneRadius = 0.5f * glm::length(sceneMax - sceneMin);
+        glm::vec3 up = std::abs(cachedDirection.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        lightView = glm::lookAt(sceneCenter - cachedDirection * sceneRadius, sceneCenter, up);
+
+        // depth range from the casters, identical for all cascades
+        glm::vec3 sceneLightMin, sceneLightMax;
+        lightSpaceBounds(sceneMin, sceneMax, sceneLightMin, sceneLightMax);
+        float nearPlane = -sceneLightMax.z - 0.5f;
+        float farPlane = -sceneLightMin.z + 0.5f;
+
+        glm::mat4 inverseView = glm::inverse(view);
+        float tanHalfFov = std::tan(0.5f * fovy);
+        float sliceNear = zNear;
+        for (int c = 0; c < cascadeCount; c++) {
+            // practical split scheme, mostly logarithmic
+            float t = (float)(c + 1) / cascadeCount;
+            float logSplit = zNear * std::pow(shadowDistance / zNear, t);
+            float uniformSplit = zNear + (shadowDistance - zNear) * t;
+            float sliceFar = glm::mix(uniformSplit, logSplit, 0.8f);
+            cascadeSplits[c] = sliceFar;
+
+            // smallest sphere around the slice, its center is on the view axis. k is the slope of the corners
+            float k = tanHalfFov * std::sqrt(1.0f + aspect * aspect);
+            float centerDepth = std::min(sliceFar, 0.5f * (sliceNear + sliceFar) * (1.0f + k * k));
+            float radius = std::sqrt((sliceFar - centerDepth) * (sliceFar - centerDepth) + sliceFar * sliceFar * k * k);
+            glm::vec4 lightCenter = lightView * inverseView * glm::vec4(0.0f, 0.0f, -centerDepth, 1.0f);
+            glm::vec2 center(lightCenter.x, lightCenter.y);
+
+            float size = 2.0f * radius * (1.0f + recenterMargin);
+            bool inside = std::abs(size - cascadeSize[c]) < 1e-4f * size &&
+                          center.x - radius >= cascadeMin[c].x && center.x + radius <= cascadeMax[c].x &&
+                          center.y - radius >= cascadeMin[c].y && center.y + radius <= cascadeMax[c].y;
+            if (!inside || directionChanged) {
+                // whole texels, the static casters land on the same texels wherever the box is placed
+                float texel = size / resolution;
+                glm::vec2 origin(std::floor((center.x - 0.5f * size) / texel) * texel,
+                                 std::floor((center.y - 0.5f * size) / texel) * texel);
+                cascadeSize[c] = size;
+                cascadeMin[c] = origin;
+                cascadeMax[c] = origin + glm::vec2(size);
+            }
+            glm::mat4 lightSpace = glm::ortho(cascadeMin[c].x, cascadeMax[c].x, cascadeMin[c].y, cascadeMax[c].y, nearPlane, farPlane) * lightView;
+            if (lightSpace != lightSpaceMatrices[c])
+                staticDirty[c] = true;
+            lightSpaceMatrices[c] = lightSpace;
+            sliceNear = sliceFar;
+        }
+        directionChanged = false;
+    }
+
+    // per cascade culling, tests a world space box against the cascade's light space rectangle
+    bool Intersects(int cascade, const glm::vec3 &worldMin, const glm::vec3 &worldMax) const
+    {
+        glm::vec3 lightMin, lightMax;
+        lightSpaceBounds(worldMin, worldMax, lightMin, lightMax);
+        return lightMax.x >= cascadeMin[cascade].x && lightMin.x <= cascadeMax[cascade].x &&
+               lightMax.y >= cascadeMin[cascade].y && lightMin.y <= cascadeMax[cascade].y;
+    }
+
+    // binds the cached layer of a cascade for the static casters. returns false while the cache is valid,
+    // in that case nothing has to be drawn.
+    bool BeginStatic(int cascade)
+    {
+        if (!staticDirty[cascade])
+            return false;
+        bindLayer(staticFBO, staticArray, cascade);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        staticDirty[cascade] = false;
+        staticRedraws++;
+        return true;
+    }
+
+    // copies the cached static depth into the per frame layer and leaves it bound for the dynamic casters
+    void BeginDynamic(int cascade)
+    {
+        bindLayer(FBO, depthArray, cascade);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, staticFBO);
+        glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, staticArray, 0, cascade);
+        glBlitFramebuffer(0, 0, resolution, resolution, 0, 0, resolution, resolution, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    }
+
+    // common state for all caster draws
+    void BeginCasters()
+    {
+        glViewport(0, 0, resolution, resolution);
+        glDisable(GL_CULL_FACE);
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(2.0f, 4.0f);
+    }
+
+    void EndCasters()
+    {
+        glDisable(GL_POLYGON_OFFSET_FILL);
+        glEnable(GL_CULL_FACE);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // binds the shadow array to a texture unit and sets the receiver uniforms
+    void Bind(Shader &shader, int unit) const
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, depthArray);
+        glActiveTexture(GL_TEXTURE0);
+        shader.setInt("shadowMap", unit);
+        for (int i = 0; i < cascadeCount; i++) {
+            shader.setMat4("lightSpaceMatrices[" + std::to_string(i) + "]", lightSpaceMatrices[i]);
+            shader.setFloat("cascadeSplits[" + std::to_string(i) + "]", cascadeSplits[i]);
+        }
+    }
+
+private:
+    unsigned int staticArray = 0;
+    unsigned int FBO = 0;
+    unsigned int staticFBO = 0;
+    bool staticDirty[cascadeCount];
+    bool hasDirection = false;
+    bool directionChanged = false;
+    glm::vec3 cachedDirection = glm::vec3(0.0f, -1.0f, 0.0f);
+    glm::mat4 lightView = glm::mat4(1.0f);
+    glm::vec2 cascadeMin[cascadeCount];
+    glm::vec2 cascadeMax[cascadeCount];
+    float cascadeSize[cascadeCount] = {};
+
+    unsigned int createArray()
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, resolution, resolution, cascadeCount, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        // hardware 2x2 PCF through the comparison sampler
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        float border[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        return texture;
+    }
+
+    void bindLayer(unsigned int framebuffer, unsigned int array, int cascade)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, array, 0, cascade);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            LOG_ERROR("Shadow framebuffer not complete!");
+    }
+
+    void lightSpaceBounds(const glm::vec3 &worldMin, const glm::vec3 &worldMax, glm::vec3 &outMin, glm::vec3 &outMax) const
+    {
+        for (int i = 0; i < 8; i++) {
+            glm::vec3 corner(i & 1 ? worldMax.x : worldMin.x, i & 2 ? worldMax.y : worldMin.y, i & 4 ? worldMax.z : worldMin.z);
+            glm::vec3 light = glm::vec3(lightView * glm::vec4(corner, 1.0f));
+            outMin = i == 0 ? light : glm::min(outMin, light);
+            outMax = i == 0 ? light : glm::max(outMax, light);
+        }
+    }
+};
+#endif
@@ -0,0 +1,161 @@
+#ifndef STATICBATCH_H
+#define STATICBATCH_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/scene.h>
+#include <learnopengl/hlod.h>
+#include <learnopengl/log.h>
+#include <learnopengl/profiler.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+using namespace std;
+
+// the static props pre-transformed into world space at load, one mesh per HLOD cell and material.
+// meshes with the same textures (or atlas entries) and the same uniform prefix draw the same way, so their
+// vertices are transformed by the object's model matrix, appended to one buffer and drawn with one call and
+// an identity model matrix. splitting by HLOD cell keeps the batches small enough to cull, and a cell that
+// draws its proxy skips its batches as a whole.
+// after the upload the CPU copies of the batches are dropped; the ones of the source meshes only when
+// keepSourceMeshes is false, anything that needs the triangles later (picking, HLOD) wants them kept.
+// opaque and alpha tested meshes batch separately, blended ones are left to the transparent pass.
+class StaticBatcher
+{
+public:
+    struct Batch {
+        Mesh mesh;
+        int hlodCell;
+        MaterialClass materialClass;
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+        bool visible;
+    };
+
+    // results of the last Select
+    int batchesDrawn = 0;
+
+    // after HLOD::Build, which assigns the cells
+    void Build(const vector<SceneObject> &objects, bool keepSourceMeshes = true)
+    {
+        PROFILE_ZONE("StaticBatcher::Build");
+        struct Group {
+            vector<Vertex> vertices;
+            vector<unsigned int> indices;
+            vector<glm::vec3> positions;
+            const Mesh *material;
+            int hlodCell;
+        };
+        map<string, Group> groups;
+        int sourceMeshes = 0;
+        for (const SceneObject& object : objects) {
+            if (!object.isStatic)
+                continue;
+            glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(object.transform)));
+            for (const Mesh& mesh : object.model->meshes) {
+                if (mesh.materialClass == MATERIAL_BLENDED)
+                    continue;
+                Group &group = groups[materialKey(mesh, object.hlodCell)];
+                group.material = &mesh;
+                group.hlodCell = object.hlodCell;
+                unsigned int base = (unsigned int) group.vertices.size();
+                for (const Vertex& source : mesh.vertices) {
+                    Vertex vertex = source;
+                    vertex.Position = glm::vec3(object.transform * glm::vec4(source.Position, 1.0f));
+                    vertex.Normal = glm::normalize(normalMatrix * source.Normal);
+                    vertex.Tangent = glm::mat3(object.transform) * source.Tangent;
+                    vertex.Bitangent = glm::mat3(object.transform) * source.Bitangent;
+                    group.vertices.push_back(vertex);
+                    group.positions.push_back(vertex.Position);
+                }
+                for (unsigned int index : mesh.indices)
+                    group.indices.push_back(base + index);
+                sourceMeshes++;
+            }
+        }
+
+        for (map<string, Group>::iterator it = groups.begin(); it != groups.end(); ++it) {
+            Group &group = it->second;
+            if (group.vertices.empty())
+                continue;
+            Batch batch{Mesh(group.vertices, group.indices, group.material->textures, group.positions), group.hlodCell,
+                        group.material->materialClass, group.positions[0], group.positions[0], false};
+            batch.mesh.atlas = group.material->atlas;
+            batch.mesh.glslIdentifierPrefix = group.material->glslIdentifierPrefix;
+            batch.mesh.materialClass = group.material->materialClass;
+            for (const glm::vec3& position : group.positions) {
+                batch.boundsMin = glm::min(batch.boundsMin, position);
+                batch.boundsMax = glm::max(batch.boundsMax, position);
+            }
+            // the index count is all Draw needs from the CPU side
+            releaseVertices(batch.mesh);
+            batches.push_back(batch);
+        }
+
+        if (!keepSourceMeshes) {
+            set<Model *> models;
+            for (const SceneObject& object : objects)
+                if (object.isStatic)
+                    models.insert(object.model);
+            // a model that is also placed as a moving object is drawn from its buffers just the same
+            for (Model *model : models)
+                for (Mesh& mesh : model->meshes)
+                    releaseVertices(mesh);
+        }
+        LOG_INFO("static batches: {} meshes in {} draws", sourceMeshes, batches.size());
+    }
+
+    // frustum culling, and the cells that draw their HLOD proxy instead, once per frame
+    void Select(const glm::mat4 &projection, const glm::mat4 &view, const HLOD &hlod)
+    {
+        Frustum frustum(projection * view);
+        batchesDrawn = 0;
+        for (Batch& batch : batches) {
+            batch.visible = !hlod.CellProxied(batch.hlodCell) && frustum.Intersects(batch.boundsMin, batch.boundsMax);
+            if (batch.visible)
+                batchesDrawn++;
+        }
+    }
+
+    // the visible batches of one material class with the program in use and an identity model matrix
+    void Draw(Shader &shader, MaterialClass materialClass)
+    {
+        for (Batch& batch : batches)
+            if (batch.visible && batch.materialClass == materialClass)
+                batch.mesh.Draw(shader);
+    }
+
+    // the opaque ones, for the depth pre-pass
+    void DrawDepth()
+    {
+        for (Batch& batch : batches)
+            if (batch.visible && batch.materialClass == MATERIAL_OPAQUE)
+                batch.mesh.DrawDepth();
+    }
+
+    // every batch, the shadow cascades cull them on their own
+    vector<Batch> &Batches() { return batches; }
+
+private:
+    vector<Batch> batches;
+
+    static string materialKey(const Mesh &mesh, int hlodCell)
+    {
+        string key = to_string(hlodCell) + "|" + to_string(mesh.materialClass) + "|" + mesh.glslIdentifierPrefix;
+        for (const Texture& texture : mesh.textures)
+            key += "|" + texture.type + ":" + to_string(texture.atlasEntry >= 0 ? 0u : texture.id) + ":" + to_string(texture.atlasEntry);
+        return key;
+    }
+
+    static void releaseVertices(Mesh &mesh)
+    {
+        vector<Vertex>().swap(mesh.vertices);
+        vector<glm::vec3>().swap(mesh.positions);
+    }
+};
+#endif
@@ -0,0 +1,308 @@
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+#include <learnopengl/scene.h>
+#include <learnopengl/profiler.h>
+#include <learnopengl/log.h>
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+using namespace std;
+
+// heightfield terrain drawn with CDLOD (continuous distance dependent level of detail).
+// every chunk is the same gridSize x gridSize mesh, placed and scaled by uniforms; terrain.vs reads the
+// height from a float texture. the chunks form a quadtree: the root covers the whole terrain and every
+// level down halves the chunk size. each frame the tree is walked from the root, a node that is further
+// from the camera than the range of the next finer level is drawn whole, otherwise its children decide for
+// themselves, and the quarters whose child is out of range are drawn at the node's level. nodes outside
+// the frustum are skipped together with their subtree, their boxes use the min/max height under them.
+// near the end of its range a vertex slides onto the grid of the next coarser level (morphRange), so
+// neighbouring levels meet without cracks and nothing pops when a chunk changes level. the vertex count
+// depends on the ranges, not on the size of the terrain.
+class Terrain
+{
+public:
+    // quads per chunk side, even so the grid can be drawn by quarters
+    static const int gridSize = 32;
+    // unit the height texture is bound to, below the texture atlas
+    static const int heightUnit = 5;
+
+    // a level 0 chunk is drawn up to lodDistance times its size away, every coarser level twice as far
+    float lodDistance = 2.0f;
+    // fraction of a level's range drawn before its vertices start morphing
+    float morphStart = 0.7f;
+    // texture repeats per meter
+    float textureScale = 0.5f;
+
+    // results of the last Draw
+    int drawnChunks = 0;
+    int drawnTriangles = 0;
+
+    // fbm hills around a flat square at flatHeight (|x| and |z| below flatExtent), blended in over blendWidth.
+    // resolution height samples per side over size meters centered on the origin, levels quadtree levels
+    void Generate(int resolution, float size, int levels, float flatExtent, float blendWidth, float flatHeight,
+                  float amplitude, unsigned int seed)
+    {
+        PROFILE_ZONE("Terrain::Generate");
+        this->resolution = resolution;
+        this->size = size;
+        this->levels = std::max(1, levels);
+        origin = glm::vec2(-0.5f * size, -0.5f * size);
+        heights.resize(resolution * resolution);
+        for (int j = 0; j < resolution; j++) {
+            for (int i = 0; i < resolution; i++) {
+                float x = origin.x + (float) i / (resolution - 1) * size;
+                float z = origin.y + (float) j / (resolution - 1) * size;
+                float edge = std::max(std::fabs(x), std::fabs(z));
+                float t = std::max(0.0f, std::min((edge - flatExtent) / blendWidth, 1.0f));
+                float blend = t * t * (3.0f - 2.0f * t);
+                float hills = 0.0f;
+                if (blend > 0.0f) {
+                    float frequency = 1.0f / 160.0f, weight = 0.5f;
+                    for (int octave = 0; octave < 5; octave++) {
+                        hills += weight * valueNoise(x * frequency, z * frequency, seed + octave);
+                        frequency *= 2.0f;
+                        weight *= 0.5f;
+                    }
+                }
+                heights[j * resolution + i] = flatHeight + amplitude * hills * blend;
+            }
+        }
+        upload();
+    }
+
+    // the shader is one of the terrain.vs programs and already in use with its lighting uniforms set
+    void Draw(Shader &shader, const glm::mat4 &projection, const glm::mat4 &view, const glm::vec3 &cameraPosition)
+    {
+        PROFILE_ZONE("Terrain::Draw");
+        // from lodDistance every frame, it can be tuned at runtime
+        ranges.resize(levels);
+        for (int level = 0; level < levels; level++)
+            ranges[level] = size / (1 << (levels - 1)) * lodDistance * (1 << level);
+        selection.clear();
+        Frustum frustum(projection * view);
+        if (!selectNode(levels - 1, 0, 0, frustum, cameraPosition))
+            selection.push_back(Selected{levels - 1, 0, 0, -1});
+
+        shader.setMat4("projection", projection);
+        shader.setMat4("view", view);
+        shader.setInt("heightMap", heightUnit);
+        shader.setVec2("terrainOrigin", origin);
+        shader.setFloat("terrainSize", size);
+        shader.setFloat("heightMapSize", (float) resolution);
+        shader.setVec3("terrainCamera", cameraPosition);
+        shader.setFloat("gridSize", (float) gridSize);
+        shader.setFloat("textureScale", textureScale);
+        glActiveTexture(GL_TEXTURE0 + heightUnit);
+        glBindTexture(GL_TEXTURE_2D, heightTexture);
+        glActiveTexture(GL_TEXTURE0);
+
+        glBindVertexArray(VAO);
+        int quarterIndices = gridSize * gridSize / 4 * 6;
+        drawnTriangles = 0;
+        for (const Selected& node : selection) {
+            float nodeSize = size / (1 << (levels - 1 - node.level));
+            shader.setVec3("chunk", glm::vec3(origin.x + node.x * nodeSize, origin.y + node.z * nodeSize, nodeSize));
+            float previous = node.level > 0 ? ranges[node.level - 1] : 0.0f;
+            shader.setVec2("morphRange", previous + (ranges[node.level] - previous) * morphStart, ranges[node.level]);
+            if (node.quarter < 0) {
+                glDrawElements(GL_TRIANGLES, 4 * quarterIndices, GL_UNSIGNED_INT, 0);
+                drawnTriangles += 4 * quarterIndices / 3;
+            } else {
+                glDrawElements(GL_TRIANGLES, quarterIndices, GL_UNSIGNED_INT,
+                               (void*)(node.quarter * quarterIndices * sizeof(unsigned int)));
+                drawnTriangles += quarterIndices / 3;
+            }
+        }
+        glBindVertexArray(0);
+        drawnChunks = (int) selection.size();
+    }
+
+    // bilinear like the vertex shader, for placing things on the ground
+    float HeightAt(float x, float z) const
+    {
+        float u = (x - origin.x) / size * (resolution - 1), v = (z - origin.y) / size * (resolution - 1);
+        u = std::max(0.0f, std::min(u, (float) (resolution - 1)));
+        v = std::max(0.0f, std::min(v, (float) (resolution - 1)));
+        int i = std::min((int) u, resolution - 2), j = std::min((int) v, resolution - 2);
+        float tx = u - i, tz = v - j;
+        float top = heights[j * resolution + i] * (1.0f - tx) + heights[j * resolution + i + 1] * tx;
+        float bottom = heights[(j + 1) * resolution + i] * (1.0f - tx) + heights[(j + 1) * resolution + i + 1] * tx;
+        return top * (1.0f - tz) + bottom * tz;
+    }
+
+    float Size() const { return size; }
+    int Levels() const { return levels; }
+
+    void Destroy()
+    {
+        if (VAO) {
+            glDeleteVertexArrays(1, &VAO);
+            glDeleteBuffers(1, &VBO);
+            glDeleteBuffers(1, &EBO);
+            glDeleteTextures(1, &heightTexture);
+        }
+        VAO = VBO = EBO = heightTexture = 0;
+    }
+
+private:
+    struct Selected {
+        int level;
+        int x;
+        int z;
+        // 0 to 3 for one quarter of the grid, -1 for all of it
+        int quarter;
+    };
+
+    int resolution = 0;
+    float size = 0.0f;
+    int levels = 1;
+    glm::vec2 origin;
+    vector<float> heights;
+    // lowest and highest height under every node, per level, finest first
+    vector<vector<glm::vec2>> minMax;
+    vector<float> ranges;
+    vector<Selected> selection;
+    unsigned int heightTexture = 0;
+    unsigned int VAO = 0, VBO = 0, EBO = 0;
+
+    static float hash(int x, int z, unsigned int seed)
+    {
+        unsigned int h = (unsigned int) x * 374761393u + (unsigned int) z * 668265263u + seed * 2246822519u;
+        h = (h ^ (h >> 13)) * 1274126177u;
+        return ((h ^ (h >> 16)) & 0xFFFFFF) / (float) 0xFFFFFF;
+    }
+
+    static float valueNoise(float x, float z, unsigned int seed)
+    {
+        int ix = (int) std::floor(x), iz = (int) std::floor(z);
+        float tx = x - ix, tz = z - iz;
+        tx = tx * tx * (3.0f - 2.0f * tx);
+        tz = tz * tz * (3.0f - 2.0f * tz);
+        float top = hash(ix, iz, seed) * (1.0f - tx) + hash(ix + 1, iz, seed) * tx;
+        float bottom = hash(ix, iz + 1, seed) * (1.0f - tx) + hash(ix + 1, iz + 1, seed) * tx;
+        return top * (1.0f - tz) + bottom * tz;
+    }
+
+    glm::vec3 nodeMin(int level, int x, int z) const
+    {
+        float nodeSize = size / (1 << (levels - 1 - level));
+        return glm::vec3(origin.x + x * nodeSize, minMax[level][z * (1 << (levels - 1 - level)) + x].x, origin.y + z * nodeSize);
+    }
+
+    glm::vec3 nodeMax(int level, int x, int z) const
+    {
+        float nodeSize = size / (1 << (levels - 1 - level));
+        return glm::vec3(origin.x + (x + 1) * nodeSize, minMax[level][z * (1 << (levels - 1 - level)) + x].y,
+                         origin.y + (z + 1) * nodeSize);
+    }
+
+    // false when the node is beyond the range of its level and the parent has to cover its area
+    bool selectNode(int level, int x, int z, const Frustum &frustum, const glm::vec3 &camera)
+    {
+        glm::vec3 boxMin = nodeMin(level, x, z), boxMax = nodeMax(level, x, z);
+        // invisible, there is nothing for the parent to draw either
+        if (!frustum.Intersects(boxMin, boxMax))
+            return true;
+        float distance = DistanceToBox(camera, boxMin, boxMax);
+        if (distance > ranges[level])
+            return false;
+        if (level == 0 || distance > ranges[level - 1]) {
+            selection.push_back(Selected{level, x, z, -1});
+            return true;
+        }
+        for (int quarter = 0; quarter < 4; quarter++) {
+            if (!selectNode(level - 1, 2 * x + (quarter & 1), 2 * z + (quarter >> 1), frustum, camera))
+                selection.push_back(Selected{level, x, z, quarter});
+        }
+        return true;
+    }
+
+    void upload()
+    {
+        Destroy();
+        glGenTextures(1, &heightTexture);
+        glBindTexture(GL_TEXTURE_2D, heightTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, resolution, resolution, 0, GL_RED, GL_FLOAT, &heights[0]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        // bounds of the leaves from the samples they touch, then every level from the four below it
+        minMax.assign(levels, vector<glm::vec2>());
+        int leaves = 1 << (levels - 1);
+        minMax[0].resize(leaves * leaves);
+        float texelsPerLeaf = (float) (resolution - 1) / leaves;
+        for (int z = 0; z < leaves; z++) {
+            for (int x = 0; x < leaves; x++) {
+                int i0 = (int) std::floor(x * texelsPerLeaf), i1 = std::min(resolution - 1, (int) std::ceil((x + 1) * texelsPerLeaf));
+                int j0 = (int) std::floor(z * texelsPerLeaf), j1 = std::min(resolution - 1, (int) std::ceil((z + 1) * texelsPerLeaf));
+                glm::vec2 bounds(heights[j0 * resolution + i0]);
+                for (int j = j0; j <= j1; j++) {
+                    for (int i = i0; i <= i1; i++) {
+                        bounds.x = std::min(bounds.x, heights[j * resolution + i]);
+                        bounds.y = std::max(bounds.y, heights[j * resolution + i]);
+                    }
+                }
+                minMax[0][z * leaves + x] = bounds;
+            }
+        }
+        for (int level = 1; level < levels; level++) {
+            int count = 1 << (levels - 1 - level);
+            minMax[level].resize(count * count);
+            for (int z = 0; z < count; z++) {
+                for (int x = 0; x < count; x++) {
+                    glm::vec2 bounds = minMax[level - 1][(2 * z) * (2 * count) + 2 * x];
+                    for (int quarter = 1; quarter < 4; quarter++) {
+                        const glm::vec2& child = minMax[level - 1][(2 * z + (quarter >> 1)) * (2 * count) + 2 * x + (quarter & 1)];
+                        bounds.x = std::min(bounds.x, child.x);
+                        bounds.y = std::max(bounds.y, child.y);
+                    }
+                    minMax[level][z * count + x] = bounds;
+                }
+            }
+        }
+        float leafSize = size / leaves;
+
+        // one grid in [0, 1]^2, the indices grouped by quarter so a quarter is one contiguous range
+        vector<glm::vec2> vertices;
+        for (int j = 0; j <= gridSize; j++)
+            for (int i = 0; i <= gridSize; i++)
+                vertices.push_back(glm::vec2((float) i / gridSize, (float) j / gridSize));
+        vector<unsigned int> indices;
+        int half = gridSize / 2;
+        for (int quarter = 0; quarter < 4; quarter++) {
+            int i0 = (quarter & 1) * half, j0 = (quarter >> 1) * half;
+            for (int j = j0; j < j0 + half; j++) {
+                for (int i = i0; i < i0 + half; i++) {
+                    unsigned int a = j * (gridSize + 1) + i, b = a + 1;
+                    unsigned int c = a + gridSize + 1, d = c + 1;
+                    // counter clockwise seen from above
+                    unsigned int quad[] = {a, c, b, b, c, d};
+                    indices.insert(indices.end(), quad, quad + 6);
+                }
+            }
+        }
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec2), &vertices[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void*)0);
+        glBindVertexArray(0);
+        LOG_INFO("terrain: {} m, {}x{} heights, {} levels, {} m chunks at level 0", size, resolution, resolution,
+                 levels, leafSize);
+    }
+};
+#endif
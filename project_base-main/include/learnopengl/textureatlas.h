@@ -0,0 +1,177 @@
+#ifndef TEXTUREATLAS_H
+#define TEXTUREATLAS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <stb_image.h>
+#include <imstb_rectpack.h>
+
+#include <learnopengl/profiler.h>
+#include <learnopengl/log.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+using namespace std;
+
+// small diffuse and specular maps of the props packed into the layers of one GL_TEXTURE_2D_ARRAY, so
+// meshes with different materials draw with the same texture binding.
+// models register their maps while they load, Build packs them with stb_rect_pack once everything is in
+// and uploads the pages. a map is placed with a gutter of wrapped pixels around it: the shader wraps the
+// coordinates itself (rect.xy + fract(uv) * rect.zw) and bilinear taps and the first mip levels across
+// the seam read what GL_REPEAT would have read. mips stop where the gutter runs out, and every placed
+// rect starts and ends on a multiple of gutter texels so no mip texel straddles two maps.
+// maps larger than maxImageSize stay ordinary textures.
+class TextureAtlas
+{
+public:
+    // unit the array is bound to, next to the shadow map on 7
+    static const int unit = 6;
+    static const int gutter = 8;
+
+    struct Entry {
+        int layer = -1;
+        // offset in xy, size in zw, in [0, 1] of the layer
+        glm::vec4 rect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+    };
+
+    unsigned int ID = 0;
+
+    TextureAtlas(int pageSize = 2048, int maxImageSize = 1024)
+        : pageSize(pageSize), maxImageSize(std::min(maxImageSize, pageSize / gutter * gutter - 2 * gutter))
+    {
+    }
+
+    // loads the image when it is small enough and returns its entry, -1 when it should be a texture of its own
+    int AddFile(const string &filename)
+    {
+        if (built)
+            return -1;
+        // models that share a file share the entry
+        map<string, int>::const_iterator known = files.find(filename);
+        if (known != files.end())
+            return known->second;
+        int width, height, components;
+        if (!stbi_info(filename.c_str(), &width, &height, &components) || width > maxImageSize || height > maxImageSize)
+            return -1;
+        Image image;
+        unsigned char *data = stbi_load(filename.c_str(), &image.width, &image.height, &components, 4);
+        if (!data)
+            return -1;
+        image.pixels.assign(data, data + image.width * image.height * 4);
+        stbi_image_free(data);
+        images.push_back(std::move(image));
+        entries.push_back(Entry());
+        files[filename] = (int) entries.size() - 1;
+        return (int) entries.size() - 1;
+    }
+
+    const Entry &Get(int index) const { return entries[index]; }
+    int Layers() const { return layers; }
+
+    // packs and uploads everything added so far, after the models are loaded
+    void Build()
+    {
+        PROFILE_ZONE("TextureAtlas::Build");
+        built = true;
+        if (images.empty())
+            return;
+
+        vector<int> remaining(images.size());
+        for (size_t i = 0; i < images.size(); i++)
+            remaining[i] = (int) i;
+        vector<int> x(images.size()), y(images.size());
+        // packed on a grid of gutter sized cells: sizes are rounded up going in, origins scaled back coming out
+        int cells = pageSize / gutter;
+        vector<stbrp_node> nodes(cells);
+        // every image fits an empty page, so each round places at least one
+        while (!remaining.empty()) {
+            stbrp_context context;
+            stbrp_init_target(&context, cells, cells, &nodes[0], (int) nodes.size());
+            vector<stbrp_rect> rects(remaining.size());
+            for (size_t i = 0; i < remaining.size(); i++) {
+                rects[i].id = remaining[i];
+                rects[i].w = aligned(images[remaining[i]].width + 2 * gutter) / gutter;
+                rects[i].h = aligned(images[remaining[i]].height + 2 * gutter) / gutter;
+            }
+            stbrp_pack_rects(&context, &rects[0], (int) rects.size());
+            remaining.clear();
+            for (const stbrp_rect& rect : rects) {
+                if (!rect.was_packed) {
+                    remaining.push_back(rect.id);
+                    continue;
+                }
+                x[rect.id] = rect.x * gutter + gutter;
+                y[rect.id] = rect.y * gutter + gutter;
+                entries[rect.id].layer = layers;
+            }
+            layers++;
+        }
+
+        glGenTextures(1, &ID);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, ID);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, pageSize, pageSize, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        size_t bytes = 0;
+        vector<unsigned char> padded;
+        for (size_t i = 0; i < images.size(); i++) {
+            const Image& image = images[i];
+            // the rounding goes to the right and bottom gutter, it is filled with wrapped pixels as well
+            int paddedWidth = aligned(image.width + 2 * gutter), paddedHeight = aligned(image.height + 2 * gutter);
+            padded.resize(paddedWidth * paddedHeight * 4);
+            for (int py = 0; py < paddedHeight; py++) {
+                int sy = ((py - gutter) % image.height + image.height) % image.height;
+                for (int px = 0; px < paddedWidth; px++) {
+                    int sx = ((px - gutter) % image.width + image.width) % image.width;
+                    std::copy_n(&image.pixels[(sy * image.width + sx) * 4], 4, &padded[(py * paddedWidth + px) * 4]);
+                }
+            }
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, x[i] - gutter, y[i] - gutter, entries[i].layer, paddedWidth,
+                            paddedHeight, 1, GL_RGBA, GL_UNSIGNED_BYTE, &padded[0]);
+            entries[i].rect = glm::vec4((float) x[i] / pageSize, (float) y[i] / pageSize,
+                                        (float) image.width / pageSize, (float) image.height / pageSize);
+            bytes += image.pixels.size();
+        }
+        // the gutter is 1 texel wide at level log2(gutter), coarser levels would blend neighbouring maps.
+        // gutter is a power of two, so the rects stay texel aligned down to that level
+        int maxLevel = 0;
+        while ((gutter >> (maxLevel + 1)) > 0)
+            maxLevel++;
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, maxLevel);
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        LOG_INFO("texture atlas: {} maps, {} KB, in {} layers of {}x{}", images.size(), bytes / 1024, layers,
+                 pageSize, pageSize);
+        // the pixels live on the GPU now
+        images.clear();
+        images.shrink_to_fit();
+    }
+
+    void Bind() const
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, ID);
+    }
+
+private:
+    struct Image {
+        int width = 0;
+        int height = 0;
+        vector<unsigned char> pixels;
+    };
+
+    int pageSize;
+    int maxImageSize;
+
+    static int aligned(int size) { return (size + gutter - 1) / gutter * gutter; }
+    bool built = false;
+    int layers = 0;
+    vector<Image> images;
+    vector<Entry> entries;
+    map<string, int> files;
+};
+#endif
@@ -0,0 +1,309 @@
+#ifndef VEGETATION_H
+#define VEGETATION_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <stb_image.h>
+
+#include <learnopengl/shader.h>
+#include <learnopengl/scene.h>
+#include <learnopengl/profiler.h>
+#include <learnopengl/log.h>
+
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cmath>
+using namespace std;
+
+// how much grass grows where, 0 bare ground to 1 full density, over a rectangle of the ground (x, z)
+class DensityMap
+{
+public:
+    int width;
+    int height;
+    glm::vec2 areaMin;
+    glm::vec2 areaMax;
+    vector<float> values;
+
+    DensityMap(int width, int height, const glm::vec2 &areaMin, const glm::vec2 &areaMax)
+        : width(width), height(height), areaMin(areaMin), areaMax(areaMax), values(width * height, 1.0f)
+    {
+    }
+
+    // a grayscale image stretched over the area, row 0 at areaMin.y
+    bool Load(const string &path)
+    {
+        int components;
+        unsigned char *data = stbi_load(path.c_str(), &width, &height, &components, 1);
+        if (!data) {
+            LOG_ERROR("density map failed to load at path: {}", path);
+            return false;
+        }
+        values.resize(width * height);
+        for (int i = 0; i < width * height; i++)
+            values[i] = data[i] / 255.0f;
+        stbi_image_free(data);
+        return true;
+    }
+
+    // patches: smooth value noise with a feature every cellSize texels, scaled into [minimum, 1]
+    void Noise(unsigned int seed, int cellSize, float minimum)
+    {
+        int latticeWidth = width / cellSize + 2, latticeHeight = height / cellSize + 2;
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+        vector<float> lattice(latticeWidth * latticeHeight);
+        for (float& value : lattice)
+            value = uniform(random);
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                float fx = (float) x / cellSize, fy = (float) y / cellSize;
+                int ix = (int) fx, iy = (int) fy;
+                float tx = fx - ix, ty = fy - iy;
+                tx = tx * tx * (3.0f - 2.0f * tx);
+                ty = ty * ty * (3.0f - 2.0f * ty);
+                float top = lattice[iy * latticeWidth + ix] * (1.0f - tx) + lattice[iy * latticeWidth + ix + 1] * tx;
+                float bottom = lattice[(iy + 1) * latticeWidth + ix] * (1.0f - tx) + lattice[(iy + 1) * latticeWidth + ix + 1] * tx;
+                float noise = top * (1.0f - ty) + bottom * ty;
+                values[y * width + x] *= minimum + (1.0f - minimum) * noise;
+            }
+        }
+    }
+
+    // no grass under a box (a bench, the slide), margin meters around it
+    void Clear(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, float margin)
+    {
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                glm::vec2 position = texelPosition(x, y);
+                if (position.x > boundsMin.x - margin && position.x < boundsMax.x + margin &&
+                    position.y > boundsMin.z - margin && position.y < boundsMax.z + margin)
+                    values[y * width + x] = 0.0f;
+            }
+        }
+    }
+
+    // bilinear, world x and z
+    float Sample(float x, float z) const
+    {
+        float fx = (x - areaMin.x) / (areaMax.x - areaMin.x) * width - 0.5f;
+        float fy = (z - areaMin.y) / (areaMax.y - areaMin.y) * height - 0.5f;
+        fx = std::max(0.0f, std::min(fx, width - 1.0f));
+        fy = std::max(0.0f, std::min(fy, height - 1.0f));
+        int x0 = (int) fx, y0 = (int) fy;
+        int x1 = std::min(x0 + 1, width - 1), y1 = std::min(y0 + 1, height - 1);
+        float tx = fx - x0, ty = fy - y0;
+        float top = values[y0 * width + x0] * (1.0f - tx) + values[y0 * width + x1] * tx;
+        float bottom = values[y1 * width + x0] * (1.0f - tx) + values[y1 * width + x1] * tx;
+        return top * (1.0f - ty) + bottom * ty;
+    }
+
+private:
+    glm::vec2 texelPosition(int x, int y) const
+    {
+        return glm::vec2(areaMin.x + (x + 0.5f) / width * (areaMax.x - areaMin.x),
+                         areaMin.y + (y + 0.5f) / height * (areaMax.y - areaMin.y));
+    }
+};
+
+// grass cards scattered over the ground from a density map. every blade is one instance of two crossed
+// quads; the instances are grouped into square chunks, each with its own VAO over its range of the shared
+// instance buffer (3.3 has no base instance) and a bounding box for frustum culling.
+// inside a chunk the blades are sorted by a random rank, so a distant chunk draws only its first
+// keep * count blades and the vertex shader shrinks the blades near the cut into the ground instead of
+// popping them. the wind is a travelling wave evaluated in the vertex shader, the CPU never touches a blade
+// after Build.
+class Vegetation
+{
+public:
+    // blades per square meter where the density map is 1
+    float bladesPerSquareMeter = 30.0f;
+    float chunkSize = 5.0f;
+    float minHeight = 0.35f;
+    float maxHeight = 0.8f;
+    // all blades up to fadeStart meters, none beyond fadeEnd
+    float fadeStart = 12.0f;
+    float fadeEnd = 30.0f;
+    glm::vec2 windDirection = glm::vec2(0.94f, 0.34f);
+    float windStrength = 0.12f;
+    float windSpeed = 1.6f;
+
+    // results of the last Draw
+    int visibleChunks = 0;
+    int drawnBlades = 0;
+
+    void Build(const DensityMap &density, float groundHeight, unsigned int seed = 1)
+    {
+        PROFILE_ZONE("Vegetation::Build");
+        Destroy();
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+        vector<Instance> instances;
+        glm::vec2 area = density.areaMax - density.areaMin;
+        int chunksX = std::max(1, (int) std::ceil(area.x / chunkSize));
+        int chunksZ = std::max(1, (int) std::ceil(area.y / chunkSize));
+        for (int cz = 0; cz < chunksZ; cz++) {
+            for (int cx = 0; cx < chunksX; cx++) {
+                float x0 = density.areaMin.x + cx * chunkSize, z0 = density.areaMin.y + cz * chunkSize;
+                float x1 = std::min(x0 + chunkSize, density.areaMax.x), z1 = std::min(z0 + chunkSize, density.areaMax.y);
+                int candidates = (int) ((x1 - x0) * (z1 - z0) * bladesPerSquareMeter);
+                size_t first = instances.size();
+                for (int i = 0; i < candidates; i++) {
+                    float x = x0 + uniform(random) * (x1 - x0), z = z0 + uniform(random) * (z1 - z0);
+                    float angle = uniform(random) * 6.2831853f;
+                    float bladeHeight = minHeight + uniform(random) * (maxHeight - minHeight);
+                    float phase = uniform(random) * 6.2831853f, rank = uniform(random);
+                    if (uniform(random) >= density.Sample(x, z))
+                        continue;
+                    Instance instance;
+                    instance.positionAngle = glm::vec4(x, groundHeight, z, angle);
+                    instance.sizePhaseRank = glm::vec4(bladeHeight * 0.8f, bladeHeight, phase, rank);
+                    instances.push_back(instance);
+                }
+                if (instances.size() == first)
+                    continue;
+                std::sort(instances.begin() + first, instances.end(), [](const Instance &a, const Instance &b) {
+                    return a.sizePhaseRank.w < b.sizePhaseRank.w;
+                });
+                Chunk chunk;
+                chunk.first = (int) first;
+                chunk.count = (int) (instances.size() - first);
+                // room for the card width and the sway
+                float reach = maxHeight * 0.4f + windStrength * maxHeight * 1.3f;
+                chunk.boundsMin = glm::vec3(x0 - reach, groundHeight, z0 - reach);
+                chunk.boundsMax = glm::vec3(x1 + reach, groundHeight + maxHeight, z1 + reach);
+                chunks.push_back(chunk);
+            }
+        }
+        blades = (int) instances.size();
+        if (chunks.empty())
+            return;
+
+        // two quads crossed at 90 degrees, 1 wide and 1 high with the root at the origin.
+        // v is flipped like the old billboards, grass.png is stored upside down
+        float card[] = {
+                // positions          // texcoords
+                -0.5f, 0.0f,  0.0f,   0.0f, 1.0f,
+                 0.5f, 0.0f,  0.0f,   1.0f, 1.0f,
+                 0.5f, 1.0f,  0.0f,   1.0f, 0.0f,
+                -0.5f, 0.0f,  0.0f,   0.0f, 1.0f,
+                 0.5f, 1.0f,  0.0f,   1.0f, 0.0f,
+                -0.5f, 1.0f,  0.0f,   0.0f, 0.0f,
+
+                 0.0f, 0.0f, -0.5f,   0.0f, 1.0f,
+                 0.0f, 0.0f,  0.5f,   1.0f, 1.0f,
+                 0.0f, 1.0f,  0.5f,   1.0f, 0.0f,
+                 0.0f, 0.0f, -0.5f,   0.0f, 1.0f,
+                 0.0f, 1.0f,  0.5f,   1.0f, 0.0f,
+                 0.0f, 1.0f, -0.5f,   0.0f, 0.0f
+        };
+        glGenBuffers(1, &cardVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, cardVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(card), card, GL_STATIC_DRAW);
+        glGenBuffers(1, &instanceVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(Instance), &instances[0], GL_STATIC_DRAW);
+
+        for (Chunk& chunk : chunks) {
+            glGenVertexArrays(1, &chunk.VAO);
+            glBindVertexArray(chunk.VAO);
+            glBindBuffer(GL_ARRAY_BUFFER, cardVBO);
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+            glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+            size_t offset = chunk.first * sizeof(Instance);
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)offset);
+            glVertexAttribDivisor(2, 1);
+            glEnableVertexAttribArray(3);
+            glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(offset + sizeof(glm::vec4)));
+            glVertexAttribDivisor(3, 1);
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        LOG_INFO("vegetation: {} blades in {} chunks, {} KB of instances", blades, chunks.size(),
+                 instances.size() * sizeof(Instance) / 1024);
+    }
+
+    // the shader is grass.vs/grass.fs and already in use, with its texture bound
+    void Draw(Shader &shader, const glm::mat4 &projection, const glm::mat4 &view, const glm::vec3 &cameraPosition, float time)
+    {
+        PROFILE_ZONE("Vegetation::Draw");
+        float windLength = std::sqrt(windDirection.x * windDirection.x + windDirection.y * windDirection.y);
+        shader.setMat4("projection", projection);
+        shader.setMat4("view", view);
+        shader.setVec3("cameraPosition", cameraPosition);
+        shader.setFloat("time", time);
+        shader.setVec2("windDirection", windLength > 0.0f ? glm::vec2(windDirection.x / windLength, windDirection.y / windLength)
+                                                          : glm::vec2(1.0f, 0.0f));
+        shader.setFloat("windStrength", windStrength);
+        shader.setFloat("windSpeed", windSpeed);
+        shader.setFloat("fadeStart", fadeStart);
+        shader.setFloat("fadeEnd", std::max(fadeEnd, fadeStart + 0.01f));
+
+        Frustum frustum(projection * view);
+        visibleChunks = 0;
+        drawnBlades = 0;
+        for (const Chunk& chunk : chunks) {
+            if (!frustum.Intersects(chunk.boundsMin, chunk.boundsMax))
+                continue;
+            // the blades of the nearest corner survive longest, the rest of the chunk fades in the shader
+            float keep = 1.0f - smoothstep(fadeStart, fadeEnd, DistanceToBox(cameraPosition, chunk.boundsMin, chunk.boundsMax));
+            int count = std::min(chunk.count, (int) std::ceil(chunk.count * keep));
+            if (count <= 0)
+                continue;
+            glBindVertexArray(chunk.VAO);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 12, count);
+            visibleChunks++;
+            drawnBlades += count;
+        }
+        glBindVertexArray(0);
+    }
+
+    int Blades() const { return blades; }
+    int Chunks() const { return (int) chunks.size(); }
+
+    void Destroy()
+    {
+        for (Chunk& chunk : chunks)
+            glDeleteVertexArrays(1, &chunk.VAO);
+        chunks.clear();
+        if (cardVBO)
+            glDeleteBuffers(1, &cardVBO);
+        if (instanceVBO)
+            glDeleteBuffers(1, &instanceVBO);
+        cardVBO = instanceVBO = 0;
+        blades = 0;
+    }
+
+private:
+    // root and rotation around y, then card width, height, wind phase and fade rank
+    struct Instance {
+        glm::vec4 positionAngle;
+        glm::vec4 sizePhaseRank;
+    };
+
+    struct Chunk {
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+        int first = 0;
+        int count = 0;
+        unsigned int VAO = 0;
+    };
+
+    vector<Chunk> chunks;
+    unsigned int cardVBO = 0;
+    unsigned int instanceVBO = 0;
+    int blades = 0;
+
+    static float smoothstep(float edge0, float edge1, float x)
+    {
+        float t = std::max(0.0f, std::min((x - edge0) / (edge1 - edge0), 1.0f));
+        return t * t * (3.0f - 2.0f * t);
+    }
+};
+#endif
@@ -7,10 +7,22 @@ in VS_OUT {
     vec2 TexCoords;
 } fs_in;
 
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
 uniform sampler2D floorTexture;
 uniform vec3 lightPos;
 uniform vec3 viewPos;
-uniform bool blinn;
+uniform DirLight dirLight;
+uniform mat4 view;
+
+// cascaded sun shadows: the shadowMap uniforms and ShadowFactor
+#include "shadows.glsl"
 
 void main()
 {
@@ -27,22 +39,26 @@ void main()
 
     // specular
     vec3 viewDir = normalize(viewPos - fs_in.FragPos);
+#ifdef BLINN
+    // Blinn-Phong specular
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), 32.0);
+#else
+    // Phong specular
     vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = 0.0;
-
-    if (blinn) {
-        // Blinn-Phong specular
-        vec3 halfwayDir = normalize(lightDir + viewDir);
-        spec = pow(max(dot(normal, halfwayDir), 0.0), 32.0);
-    } else {
-        // Phong specular
-        vec3 reflectDir = reflect(-lightDir, normal);
-        spec = pow(max(dot(viewDir, reflectDir), 0.0), 2.0);
-    }
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 2.0);
+#endif
 
     // Adjust specular intensity
     float specularIntensity = 0.5; // Adjust this value to control specular intensity
     vec3 specular = specularIntensity * spec * color; // Apply specular to color
 
-    FragColor = vec4(ambient + diffuse + specular, 1.0);
+    // sun
+    vec3 sunDir = normalize(-dirLight.direction);
+    float sunDiff = max(dot(normal, sunDir), 0.0);
+    float viewDepth = -(view * vec4(fs_in.FragPos, 1.0)).z;
+    float bias = max(0.002 * (1.0 - dot(normal, sunDir)), 0.0005);
+    vec3 sun = dirLight.diffuse * sunDiff * color * ShadowFactor(fs_in.FragPos, viewDepth, bias);
+
+    FragColor = vec4(ambient + diffuse + specular + sun, 1.0);
 }
\ No newline at end of file
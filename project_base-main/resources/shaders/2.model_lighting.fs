@@ -1,6 +1,14 @@
 #version 330 core
 out vec4 FragColor;
 
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
 struct PointLight {
     vec3 position;
 
@@ -16,6 +24,11 @@ struct PointLight {
 struct Material {
     sampler2D texture_diffuse1;
     sampler2D texture_specular1;
+    // layer and rect of the maps in the texture atlas, layer -1 when they are texture_diffuse1/specular1
+    float diffuseLayer;
+    vec4 diffuseRect;
+    float specularLayer;
+    vec4 specularRect;
 
     float shininess;
 };
@@ -24,41 +37,69 @@ in vec3 Normal;
 in vec3 FragPos;
 
 uniform PointLight pointLight;
+uniform DirLight dirLight;
 uniform Material material;
+uniform sampler2DArray atlas;
+
+// maps packed by textureatlas.h are read from the array and wrapped by hand. the gradients are the ones of
+// the unwrapped coordinates, so the mip level doesn't jump at the seam
+vec4 MaterialTexture(sampler2D map, float layer, vec4 rect)
+{
+    if (layer < 0.0)
+        return texture(map, TexCoords);
+    return textureGrad(atlas, vec3(rect.xy + fract(TexCoords) * rect.zw, layer), dFdx(TexCoords) * rect.zw,
+                       dFdy(TexCoords) * rect.zw);
+}
 
 uniform vec3 viewPosition;
+uniform mat4 view;
+
+// cascaded sun shadows: the shadowMap uniforms and ShadowFactor
+#include "shadows.glsl"
+
 // calculates the color when using a point light.
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 albedo)
 {
     vec3 lightDir = normalize(light.position - fragPos);
 
     // Diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
 
-    // Blinn-Phong specular shading
-    vec3 halfwayDir = normalize(lightDir + viewDir);
-    float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
-
     // Attenuation
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * 2.0 * distance + light.quadratic * 2.0 * (distance * distance)); // Povećajte opadanje svetlosti
 
-    // Combine results
-    vec3 ambient = light.ambient * 0.05 * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * 0.6 * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * 0.0* vec3(texture(material.texture_specular1, TexCoords));
+    // Combine results, the point light has no specular term
+    vec3 ambient = light.ambient * 0.05 * albedo;
+    vec3 diffuse = light.diffuse * diff * 0.6 * albedo;
 
     ambient *= attenuation;
     diffuse *= attenuation;
-    specular *= attenuation;
 
-    return (ambient + diffuse + specular);
+    return (ambient + diffuse);
+}
+
+// the sun, only ambient and diffuse like the point light above
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 fragPos, vec3 albedo)
+{
+    vec3 lightDir = normalize(-light.direction);
+    float diff = max(dot(normal, lightDir), 0.0);
+    float viewDepth = -(view * vec4(fragPos, 1.0)).z;
+    float bias = max(0.002 * (1.0 - dot(normal, lightDir)), 0.0005);
+    return light.ambient * albedo + light.diffuse * diff * albedo * ShadowFactor(fragPos, viewDepth, bias);
 }
 
 void main()
 {
     vec3 normal = normalize(Normal);
-    vec3 viewDir = normalize(viewPosition - FragPos);
-    vec3 result = CalcPointLight(pointLight, normal, FragPos, viewDir);
+    vec4 diffuse = MaterialTexture(material.texture_diffuse1, material.diffuseLayer, material.diffuseRect);
+#ifdef ALPHA_TEST
+    // only this variant discards, the opaque meshes keep early-Z
+    if (diffuse.a < 0.5)
+        discard;
+#endif
+    vec3 albedo = diffuse.rgb;
+    vec3 result = CalcPointLight(pointLight, normal, FragPos, albedo);
+    result += CalcDirLight(dirLight, normal, FragPos, albedo);
     FragColor = vec4(result, 1.0);
 }
\ No newline at end of file
@@ -10,11 +10,17 @@ out vec3 FragPos;
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+// transpose(inverse(mat3(model))), computed once per object on the CPU
+uniform mat3 normalMatrix;
+
+// must match depth_prepass.vs exactly, the lighting pass runs with GL_EQUAL after the pre-pass
+invariant gl_Position;
 
 void main()
 {
     FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = aNormal;
+    // batches come in world space and draw with an identity normalMatrix
+    Normal = normalMatrix * aNormal;
     TexCoords = aTexCoords;    
     gl_Position = projection * view * vec4(FragPos, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,154 @@
+#version 330 core
+out vec4 FragColor;
+
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct PointLight {
+    vec3 position;
+
+    vec3 specular;
+    vec3 diffuse;
+    vec3 ambient;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+struct Material {
+    sampler2D texture_diffuse1;
+    sampler2D texture_specular1;
+    // layer and rect of the maps in the texture atlas, layer -1 when they are texture_diffuse1/specular1
+    float diffuseLayer;
+    vec4 diffuseRect;
+    float specularLayer;
+    vec4 specularRect;
+
+    float shininess;
+};
+in vec2 TexCoords;
+in vec3 Normal;
+in vec3 FragPos;
+
+uniform PointLight pointLight;
+uniform DirLight dirLight;
+uniform Material material;
+uniform sampler2DArray atlas;
+
+// maps packed by textureatlas.h are read from the array and wrapped by hand. the gradients are the ones of
+// the unwrapped coordinates, so the mip level doesn't jump at the seam
+vec4 MaterialTexture(sampler2D map, float layer, vec4 rect)
+{
+    if (layer < 0.0)
+        return texture(map, TexCoords);
+    return textureGrad(atlas, vec3(rect.xy + fract(TexCoords) * rect.zw, layer), dFdx(TexCoords) * rect.zw,
+                       dFdy(TexCoords) * rect.zw);
+}
+
+uniform vec3 viewPosition;
+uniform mat4 view;
+
+// cluster data built on the CPU every frame, see clusters.h
+uniform samplerBuffer lightData;     // 3 texels per light: position/radius, color/cos inner, direction/cos outer
+uniform usamplerBuffer clusterGrid;  // offset into lightIndices, light count
+uniform usamplerBuffer lightIndices;
+uniform int clusterCountX;
+uniform int clusterCountY;
+uniform int clusterCountZ;
+uniform vec2 clusterTileSize;
+uniform float clusterSliceScale;
+uniform float clusterSliceBias;
+
+// cascaded sun shadows: the shadowMap uniforms and ShadowFactor
+#include "shadows.glsl"
+
+// calculates the color when using a point light.
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+
+    // Diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+
+    // Attenuation
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * 2.0 * distance + light.quadratic * 2.0 * (distance * distance)); // Povećajte opadanje svetlosti
+
+    // Combine results, the specular term of 2.model_lighting.fs is weighted by 0.0 so it is left out
+    vec3 ambient = light.ambient * 0.05 * albedo;
+    vec3 diffuse = light.diffuse * diff * 0.6 * albedo;
+
+    return (ambient + diffuse) * attenuation;
+}
+
+// the sun, only ambient and diffuse like the point light above
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 fragPos, vec3 albedo)
+{
+    vec3 lightDir = normalize(-light.direction);
+    float diff = max(dot(normal, lightDir), 0.0);
+    float viewDepth = -(view * vec4(fragPos, 1.0)).z;
+    float bias = max(0.002 * (1.0 - dot(normal, lightDir)), 0.0005);
+    return light.ambient * albedo + light.diffuse * diff * albedo * ShadowFactor(fragPos, viewDepth, bias);
+}
+
+// lamp light with a finite radius, same falloff as deferred_light.fs
+vec3 CalcLocalLight(int index, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, float specularMask)
+{
+    vec4 positionRadius = texelFetch(lightData, index * 3);
+    vec4 colorInner = texelFetch(lightData, index * 3 + 1);
+    vec4 directionOuter = texelFetch(lightData, index * 3 + 2);
+
+    vec3 toLight = positionRadius.xyz - fragPos;
+    float distance = length(toLight);
+    if (distance >= positionRadius.w)
+        return vec3(0.0);
+    vec3 lightDir = toLight / distance;
+
+    float diff = max(dot(normal, lightDir), 0.0);
+    float spec = pow(max(dot(normal, normalize(lightDir + viewDir)), 0.0), material.shininess);
+
+    float window = clamp(1.0 - pow(distance / positionRadius.w, 4.0), 0.0, 1.0);
+    float attenuation = window * window / (distance * distance + 1.0);
+
+    float intensity = 1.0;
+    if (directionOuter.w > -1.0) {
+        float theta = dot(-lightDir, directionOuter.xyz);
+        intensity = clamp((theta - directionOuter.w) / (colorInner.w - directionOuter.w), 0.0, 1.0);
+    }
+
+    return colorInner.rgb * (diff * albedo + spec * specularMask) * attenuation * intensity;
+}
+
+void main()
+{
+    vec3 normal = normalize(Normal);
+    vec3 viewDir = normalize(viewPosition - FragPos);
+    vec4 diffuse = MaterialTexture(material.texture_diffuse1, material.diffuseLayer, material.diffuseRect);
+#ifdef ALPHA_TEST
+    // cutouts, same as in 2.model_lighting.fs
+    if (diffuse.a < 0.5)
+        discard;
+#endif
+    vec3 albedo = diffuse.rgb;
+    float specularMask = MaterialTexture(material.texture_specular1, material.specularLayer, material.specularRect).r;
+    vec3 result = CalcPointLight(pointLight, normal, FragPos, viewDir, albedo);
+    result += CalcDirLight(dirLight, normal, FragPos, albedo);
+
+    // find this fragment's cluster and walk only its lights
+    float viewDepth = -(view * vec4(FragPos, 1.0)).z;
+    ivec3 cluster = ivec3(ivec2(gl_FragCoord.xy / clusterTileSize), int(log(viewDepth) * clusterSliceScale - clusterSliceBias));
+    cluster = clamp(cluster, ivec3(0), ivec3(clusterCountX - 1, clusterCountY - 1, clusterCountZ - 1));
+    uvec2 offsetCount = texelFetch(clusterGrid, cluster.x + clusterCountX * (cluster.y + clusterCountY * cluster.z)).rg;
+    for (uint i = 0u; i < offsetCount.y; i++) {
+        int index = int(texelFetch(lightIndices, int(offsetCount.x + i)).r);
+        result += CalcLocalLight(index, normal, FragPos, viewDir, albedo, specularMask);
+    }
+
+    FragColor = vec4(result, 1.0);
+}
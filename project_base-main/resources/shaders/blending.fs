@@ -1,6 +1,9 @@
 #version 330 core
-layout (location = 0) out vec4 FragColor;
-layout (location = 1) out vec4 BrightColor;
+// weighted blended order independent transparency (McGuire and Bavoil 2013), drawn into the targets of
+// RenderTargets::transparencyFBO with glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA)
+// and resolved by oit_resolve.fs
+layout (location = 0) out vec4 Accumulation;
+layout (location = 1) out vec4 Weight;
 
 struct DirLight {
     vec3 direction;
@@ -13,8 +16,14 @@ struct DirLight {
 struct Material {
     sampler2D texture_diffuse1;
     sampler2D texture_specular1;
+    // layer and rect of the maps in the texture atlas, layer -1 when they are texture_diffuse1/specular1
+    float diffuseLayer;
+    vec4 diffuseRect;
+    float specularLayer;
+    vec4 specularRect;
 
     float shininess;
+    float opacity;
 };
 
 
@@ -27,6 +36,17 @@ uniform DirLight dirLight;
 uniform Material material;
 
 uniform vec3 viewPosition;
+uniform sampler2DArray atlas;
+
+// maps packed by textureatlas.h are read from the array and wrapped by hand. the gradients are the ones of
+// the unwrapped coordinates, so the mip level doesn't jump at the seam
+vec4 MaterialTexture(sampler2D map, float layer, vec4 rect)
+{
+    if (layer < 0.0)
+        return texture(map, TexCoords);
+    return textureGrad(atlas, vec3(rect.xy + fract(TexCoords) * rect.zw, layer), dFdx(TexCoords) * rect.zw,
+                       dFdy(TexCoords) * rect.zw);
+}
 
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
 {
@@ -40,9 +60,10 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
 
     // Combine results
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords));
+    vec3 albedo = MaterialTexture(material.texture_diffuse1, material.diffuseLayer, material.diffuseRect).rgb;
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * spec * MaterialTexture(material.texture_specular1, material.specularLayer, material.specularRect).rgb;
 
     return (ambient + diffuse + specular);
 }
@@ -52,12 +73,10 @@ void main()
     vec3 normal = normalize(Normal);
     vec3 viewDir = normalize(viewPosition - FragPos);
     vec3 result = CalcDirLight(dirLight, normal, viewDir);
-    vec4 texColor = texture(material.texture_diffuse1, TexCoords);
-    float brightness = dot(result, vec3(0.2126, 0.7152, 0.0722));
-    if(brightness > 0.93)
-        BrightColor = vec4(result, 1.0);
-    else
-        BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
-    FragColor = texture(material.texture_diffuse1, TexCoords)*vec4(result, 0.60);
-
-}
\ No newline at end of file
+    vec4 color = MaterialTexture(material.texture_diffuse1, material.diffuseLayer, material.diffuseRect) * vec4(result, material.opacity);
+    // close fragments count more, the weight falls off with the cube of the depth
+    float weight = clamp(color.a * max(1e-2, 3e3 * pow(1.0 - gl_FragCoord.z, 3.0)), 1e-2, 3e3);
+    // rgb adds up, alpha multiplies (1 - alpha) into the revealage
+    Accumulation = vec4(color.rgb * color.a * weight, color.a);
+    Weight = vec4(color.a * weight);
+}
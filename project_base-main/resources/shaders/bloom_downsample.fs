@@ -0,0 +1,46 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D srcTexture;
+uniform vec2 srcTexelSize;
+// rendered part of the source, below 1 for the scene at a reduced render resolution
+uniform vec2 srcUvScale;
+
+vec3 Sample(vec2 offset)
+{
+    vec2 uv = min(TexCoords * srcUvScale + offset, srcUvScale - 0.5 * srcTexelSize);
+    return texture(srcTexture, uv).rgb;
+}
+
+// 13 bilinear taps: four overlapping 2x2 boxes around the center plus the center box,
+// wide enough that halving the resolution does not alias
+void main()
+{
+    float x = srcTexelSize.x;
+    float y = srcTexelSize.y;
+
+    vec3 a = Sample(vec2(-2.0 * x,  2.0 * y));
+    vec3 b = Sample(vec2( 0.0,      2.0 * y));
+    vec3 c = Sample(vec2( 2.0 * x,  2.0 * y));
+
+    vec3 d = Sample(vec2(-2.0 * x,  0.0));
+    vec3 e = Sample(vec2(0.0));
+    vec3 f = Sample(vec2( 2.0 * x,  0.0));
+
+    vec3 g = Sample(vec2(-2.0 * x, -2.0 * y));
+    vec3 h = Sample(vec2( 0.0,     -2.0 * y));
+    vec3 i = Sample(vec2( 2.0 * x, -2.0 * y));
+
+    vec3 j = Sample(vec2(-x,  y));
+    vec3 k = Sample(vec2( x,  y));
+    vec3 l = Sample(vec2(-x, -y));
+    vec3 m = Sample(vec2( x, -y));
+
+    vec3 result = e * 0.125;
+    result += (a + c + g + i) * 0.03125;
+    result += (b + d + f + h) * 0.0625;
+    result += (j + k + l + m) * 0.125;
+    FragColor = vec4(max(result, 0.0001), 1.0);
+}
@@ -0,0 +1,91 @@
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec4 BrightColor;
+
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct PointLight {
+    vec3 position;
+
+    vec3 specular;
+    vec3 diffuse;
+    vec3 ambient;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+in vec2 TexCoords;
+
+uniform sampler2D gAlbedoSpec;
+uniform sampler2D gNormalRoughness;
+uniform sampler2D gDepth;
+
+uniform mat4 inverseProjection;
+// part of the G-buffer covered by the scene at the current render resolution
+uniform vec2 uvScale;
+uniform mat4 inverseView;
+// all light positions and directions are in view space
+uniform DirLight dirLight;
+uniform PointLight pointLight;
+
+// cascaded sun shadows: the shadowMap uniforms and ShadowFactor
+#include "shadows.glsl"
+
+vec3 DecodeOctahedral(vec2 f)
+{
+    f = f * 2.0 - 1.0;
+    vec3 n = vec3(f.x, f.y, 1.0 - abs(f.x) - abs(f.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+vec3 ViewPositionFromDepth(vec2 uv, float depth)
+{
+    vec4 view = inverseProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    return view.xyz / view.w;
+}
+
+void main()
+{
+    float depth = texture(gDepth, TexCoords * uvScale).r;
+    // nothing was rasterized here, the skybox fills it in later
+    if (depth == 1.0)
+        discard;
+
+    vec4 albedoSpec = texture(gAlbedoSpec, TexCoords * uvScale);
+    vec4 normalRoughness = texture(gNormalRoughness, TexCoords * uvScale);
+    vec3 albedo = albedoSpec.rgb;
+    vec3 normal = DecodeOctahedral(normalRoughness.rg);
+    float shininess = 2.0 / max(normalRoughness.b * normalRoughness.b, 1e-4) - 2.0;
+    vec3 fragPos = ViewPositionFromDepth(TexCoords, depth);
+    vec3 viewDir = normalize(-fragPos);
+
+    // sun
+    vec3 lightDir = normalize(-dirLight.direction);
+    float diff = max(dot(normal, lightDir), 0.0);
+    float spec = pow(max(dot(normal, normalize(lightDir + viewDir)), 0.0), shininess);
+    float bias = max(0.002 * (1.0 - dot(normal, lightDir)), 0.0005);
+    float shadow = ShadowFactor(vec3(inverseView * vec4(fragPos, 1.0)), -fragPos.z, bias);
+    vec3 result = dirLight.ambient * albedo + (dirLight.diffuse * diff * albedo + dirLight.specular * spec * albedoSpec.a) * shadow;
+
+    // the light that follows the camera, same weights as 2.model_lighting.fs
+    lightDir = normalize(pointLight.position - fragPos);
+    diff = max(dot(normal, lightDir), 0.0);
+    float distance = length(pointLight.position - fragPos);
+    float attenuation = 1.0 / (pointLight.constant + pointLight.linear * 2.0 * distance + pointLight.quadratic * 2.0 * (distance * distance));
+    result += (pointLight.ambient * 0.05 * albedo + pointLight.diffuse * diff * 0.6 * albedo) * attenuation;
+
+    float brightness = dot(result, vec3(0.2126, 0.7152, 0.0722));
+    BrightColor = brightness > 1.0 ? vec4(result, 1.0) : vec4(0.0, 0.0, 0.0, 1.0);
+    FragColor = vec4(result, 1.0);
+}
@@ -0,0 +1,72 @@
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec4 BrightColor;
+
+in vec2 TexCoords;
+flat in vec4 PositionRadius;
+flat in vec4 ColorInner;
+flat in vec4 DirectionOuter;
+
+uniform sampler2D gAlbedoSpec;
+uniform sampler2D gNormalRoughness;
+uniform sampler2D gDepth;
+
+uniform mat4 inverseProjection;
+// part of the G-buffer covered by the scene at the current render resolution
+uniform vec2 uvScale;
+
+vec3 DecodeOctahedral(vec2 f)
+{
+    f = f * 2.0 - 1.0;
+    vec3 n = vec3(f.x, f.y, 1.0 - abs(f.x) - abs(f.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+vec3 ViewPositionFromDepth(vec2 uv, float depth)
+{
+    vec4 view = inverseProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    return view.xyz / view.w;
+}
+
+void main()
+{
+    float depth = texture(gDepth, TexCoords * uvScale).r;
+    if (depth == 1.0)
+        discard;
+    vec3 fragPos = ViewPositionFromDepth(TexCoords, depth);
+    vec3 toLight = PositionRadius.xyz - fragPos;
+    float distance = length(toLight);
+    // the screen rectangle is conservative, skip the pixels outside the light's sphere
+    if (distance >= PositionRadius.w)
+        discard;
+
+    vec4 albedoSpec = texture(gAlbedoSpec, TexCoords * uvScale);
+    vec4 normalRoughness = texture(gNormalRoughness, TexCoords * uvScale);
+    vec3 normal = DecodeOctahedral(normalRoughness.rg);
+    float shininess = 2.0 / max(normalRoughness.b * normalRoughness.b, 1e-4) - 2.0;
+
+    vec3 lightDir = toLight / distance;
+    vec3 viewDir = normalize(-fragPos);
+    float diff = max(dot(normal, lightDir), 0.0);
+    float spec = pow(max(dot(normal, normalize(lightDir + viewDir)), 0.0), shininess);
+
+    // windowed inverse square falloff, reaches zero exactly at the radius
+    float window = clamp(1.0 - pow(distance / PositionRadius.w, 4.0), 0.0, 1.0);
+    float attenuation = window * window / (distance * distance + 1.0);
+
+    // spot cone, point lights have an outer cos of -1
+    float intensity = 1.0;
+    if (DirectionOuter.w > -1.0) {
+        float theta = dot(-lightDir, DirectionOuter.xyz);
+        intensity = clamp((theta - DirectionOuter.w) / (ColorInner.w - DirectionOuter.w), 0.0, 1.0);
+    }
+
+    vec3 result = ColorInner.rgb * (diff * albedoSpec.rgb + spec * albedoSpec.a) * attenuation * intensity;
+
+    float brightness = dot(result, vec3(0.2126, 0.7152, 0.0722));
+    BrightColor = brightness > 1.0 ? vec4(result, 1.0) : vec4(0.0, 0.0, 0.0, 1.0);
+    FragColor = vec4(result, 1.0);
+}
@@ -0,0 +1,22 @@
+#version 330 core
+layout (location = 0) in vec2 aCorner;
+// per light instance
+layout (location = 1) in vec4 aRect;           // screen rectangle in NDC, xy = min, zw = max
+layout (location = 2) in vec4 aPositionRadius; // view space position, radius
+layout (location = 3) in vec4 aColorInner;     // color, cos of the inner spot cone
+layout (location = 4) in vec4 aDirectionOuter; // view space spot direction, cos of the outer cone (-1 for point lights)
+
+out vec2 TexCoords;
+flat out vec4 PositionRadius;
+flat out vec4 ColorInner;
+flat out vec4 DirectionOuter;
+
+void main()
+{
+    vec2 ndc = mix(aRect.xy, aRect.zw, aCorner);
+    TexCoords = ndc * 0.5 + 0.5;
+    PositionRadius = aPositionRadius;
+    ColorInner = aColorInner;
+    DirectionOuter = aDirectionOuter;
+    gl_Position = vec4(ndc, 0.0, 1.0);
+}
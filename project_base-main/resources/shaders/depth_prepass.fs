@@ -0,0 +1,34 @@
+#version 330 core
+
+#ifdef ALPHA_TEST
+struct Material {
+    sampler2D texture_diffuse1;
+    // layer and rect of the diffuse map in the texture atlas, layer -1 when it is texture_diffuse1
+    float diffuseLayer;
+    vec4 diffuseRect;
+};
+
+in vec2 TexCoords;
+
+uniform Material material;
+uniform sampler2DArray atlas;
+
+// same as in 2.model_lighting.fs
+vec4 MaterialTexture(sampler2D map, float layer, vec4 rect)
+{
+    if (layer < 0.0)
+        return texture(map, TexCoords);
+    return textureGrad(atlas, vec3(rect.xy + fract(TexCoords) * rect.zw, layer), dFdx(TexCoords) * rect.zw,
+                       dFdy(TexCoords) * rect.zw);
+}
+#endif
+
+void main()
+{
+    // depth only, the color writes are masked off during the pre-pass
+#ifdef ALPHA_TEST
+    // the cutouts cast the same shadow the lit shaders leave of them
+    if (MaterialTexture(material.texture_diffuse1, material.diffuseLayer, material.diffuseRect).a < 0.5)
+        discard;
+#endif
+}
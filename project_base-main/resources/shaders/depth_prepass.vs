@@ -0,0 +1,24 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+#ifdef ALPHA_TEST
+// the cutouts are drawn from the full vertex layout, the position-only stream has no texture coordinates
+layout (location = 2) in vec2 aTexCoords;
+
+out vec2 TexCoords;
+#endif
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+// gl_Position has to be bit-identical to 2.model_lighting.vs so the lighting pass can use GL_EQUAL
+invariant gl_Position;
+
+void main()
+{
+#ifdef ALPHA_TEST
+    TexCoords = aTexCoords;
+#endif
+    vec3 FragPos = vec3(model * vec4(aPos, 1.0));
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -0,0 +1,59 @@
+#version 330 core
+layout (location = 0) out vec4 gAlbedoSpec;
+layout (location = 1) out vec4 gNormalRoughness;
+
+struct Material {
+    sampler2D texture_diffuse1;
+    sampler2D texture_specular1;
+    // layer and rect of the maps in the texture atlas, layer -1 when they are texture_diffuse1/specular1
+    float diffuseLayer;
+    vec4 diffuseRect;
+    float specularLayer;
+    vec4 specularRect;
+
+    float shininess;
+};
+
+in vec2 TexCoords;
+in vec3 ViewNormal;
+
+uniform Material material;
+uniform sampler2DArray atlas;
+
+// maps packed by textureatlas.h are read from the array and wrapped by hand. the gradients are the ones of
+// the unwrapped coordinates, so the mip level doesn't jump at the seam
+vec4 MaterialTexture(sampler2D map, float layer, vec4 rect)
+{
+    if (layer < 0.0)
+        return texture(map, TexCoords);
+    return textureGrad(atlas, vec3(rect.xy + fract(TexCoords) * rect.zw, layer), dFdx(TexCoords) * rect.zw,
+                       dFdy(TexCoords) * rect.zw);
+}
+
+vec2 OctWrap(vec2 v)
+{
+    return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// maps a unit vector onto the octahedron and unfolds it into [0, 1]^2
+vec2 EncodeOctahedral(vec3 n)
+{
+    n /= (abs(n.x) + abs(n.y) + abs(n.z));
+    n.xy = n.z >= 0.0 ? n.xy : OctWrap(n.xy);
+    return n.xy * 0.5 + 0.5;
+}
+
+void main()
+{
+    vec4 diffuse = MaterialTexture(material.texture_diffuse1, material.diffuseLayer, material.diffuseRect);
+#ifdef ALPHA_TEST
+    // cutouts only, see MaterialClass in mesh.h
+    if (diffuse.a < 0.5)
+        discard;
+#endif
+    gAlbedoSpec.rgb = diffuse.rgb;
+    gAlbedoSpec.a = MaterialTexture(material.texture_specular1, material.specularLayer, material.specularRect).r;
+    // Blinn-Phong exponent stored as roughness so it fits a 10 bit channel
+    float roughness = sqrt(2.0 / (material.shininess + 2.0));
+    gNormalRoughness = vec4(EncodeOctahedral(normalize(ViewNormal)), roughness, 1.0);
+}
@@ -0,0 +1,20 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+
+out vec2 TexCoords;
+out vec3 ViewNormal;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+// mat3(view) * transpose(inverse(mat3(model))), computed once per object on the CPU
+uniform mat3 normalMatrix;
+
+void main()
+{
+    TexCoords = aTexCoords;
+    ViewNormal = normalMatrix * aNormal;
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+}
@@ -0,0 +1,16 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+in float Height;
+
+uniform sampler2D texture1;
+
+void main()
+{
+    vec4 texColor = texture(texture1, TexCoords);
+    if(texColor.a < 0.1)
+        discard;
+    // the bottom of the field is shadowed by the blades around it
+    FragColor = vec4(texColor.rgb * mix(0.55, 1.0, Height), texColor.a);
+}
@@ -0,0 +1,42 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoords;
+// per blade, see vegetation.h: root and rotation around y, then card width, height, wind phase and fade rank
+layout (location = 2) in vec4 aPositionAngle;
+layout (location = 3) in vec4 aSizePhaseRank;
+
+out vec2 TexCoords;
+out float Height;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 cameraPosition;
+uniform float time;
+uniform vec2 windDirection;
+uniform float windStrength;
+uniform float windSpeed;
+uniform float fadeStart;
+uniform float fadeEnd;
+
+void main()
+{
+    vec3 root = aPositionAngle.xyz;
+    // the fraction of blades kept at this distance; the ones ranked just above it shrink into the ground
+    float keep = 1.0 - smoothstep(fadeStart, fadeEnd, distance(cameraPosition, root));
+    float grow = clamp((keep - aSizePhaseRank.w) * 10.0, 0.0, 1.0);
+
+    float s = sin(aPositionAngle.w);
+    float c = cos(aPositionAngle.w);
+    vec2 local = vec2(aPos.x * c - aPos.z * s, aPos.x * s + aPos.z * c) * aSizePhaseRank.x;
+
+    // a wave travelling across the field along the wind plus a faster flutter per blade. the bend grows
+    // with the square of the height, so the root stays put
+    float wave = sin(time * windSpeed - dot(root.xz, windDirection) * 0.35 + aSizePhaseRank.z)
+               + 0.3 * sin(time * windSpeed * 2.7 + aSizePhaseRank.z * 3.0);
+    vec2 sway = windDirection * (wave * windStrength * aPos.y * aPos.y * aSizePhaseRank.y);
+
+    vec3 world = root + grow * vec3(local.x + sway.x, aPos.y * aSizePhaseRank.y, local.y + sway.y);
+    TexCoords = aTexCoords;
+    Height = aPos.y;
+    gl_Position = projection * view * vec4(world, 1.0);
+}
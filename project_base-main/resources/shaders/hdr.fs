@@ -5,31 +5,28 @@ in vec2 TexCoords;
 
 uniform sampler2D hdrBuffer;
 uniform sampler2D bloomBlur;
-uniform bool hdr;
-uniform bool bloom;
+// HDR tone maps, BLOOM adds the bloom chain. the chain sums all of its levels, bloomStrength averages them
+uniform float bloomStrength;
 uniform float exposure;
+// the scene only covers this part of hdrBuffer when it was rendered below the window resolution
+uniform vec2 uvScale;
 
 void main()
 {
     const float gamma = 1.5;
-    vec3 hdrColor = texture(hdrBuffer, TexCoords).rgb;
-    vec3 bloomColor = texture(bloomBlur, TexCoords).rgb;
+    // upscale to the window, clamped so the bilinear filter never reaches outside the rendered area
+    vec2 sceneCoords = min(TexCoords * uvScale, uvScale - 0.5 / vec2(textureSize(hdrBuffer, 0)));
+    vec3 hdrColor = texture(hdrBuffer, sceneCoords).rgb;
 
-    if(bloom)
-            hdrColor += bloomColor; // additive blending
+#ifdef BLOOM
+    hdrColor += texture(bloomBlur, TexCoords).rgb * bloomStrength; // additive blending
+#endif
 
-//     vec3 result = vec3(0.1f);
-
-    if(hdr)
-    {
-        vec3 result = vec3(1.0) - exp(-hdrColor * exposure);
-        // also gamma correct while we're at it
-        result = pow(result, vec3(1.0 / gamma));
-        FragColor = vec4(result, 1.0);
-    }
-    else
-    {
-        vec3 result = pow(hdrColor, vec3(1.0 / gamma));
-        FragColor = vec4(result, 1.0);
-    }
-}
\ No newline at end of file
+#ifdef HDR
+    vec3 result = vec3(1.0) - exp(-hdrColor * exposure);
+#else
+    vec3 result = hdrColor;
+#endif
+    // also gamma correct while we're at it
+    FragColor = vec4(pow(result, vec3(1.0 / gamma)), 1.0);
+}
@@ -0,0 +1,69 @@
+#version 330 core
+// the G-buffer outputs in the deferred path, the lit color otherwise
+#ifdef GBUFFER
+layout (location = 0) out vec4 gAlbedoSpec;
+layout (location = 1) out vec4 gNormalRoughness;
+#else
+out vec4 FragColor;
+#endif
+
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct PointLight {
+    vec3 position;
+
+    vec3 specular;
+    vec3 diffuse;
+    vec3 ambient;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec3 Color;
+
+uniform mat4 view;
+uniform PointLight pointLight;
+uniform DirLight dirLight;
+
+vec2 OctWrap(vec2 v)
+{
+    return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// maps a unit vector onto the octahedron and unfolds it into [0, 1]^2
+vec2 EncodeOctahedral(vec3 n)
+{
+    n /= (abs(n.x) + abs(n.y) + abs(n.z));
+    n.xy = n.z >= 0.0 ? n.xy : OctWrap(n.xy);
+    return n.xy * 0.5 + 0.5;
+}
+
+void main()
+{
+    vec3 normal = normalize(Normal);
+#ifdef GBUFFER
+    gAlbedoSpec = vec4(Color, 0.0);
+    // shininess 32 like the props, see gbuffer.fs
+    gNormalRoughness = vec4(EncodeOctahedral(normalize(mat3(view) * normal)), sqrt(2.0 / 34.0), 1.0);
+#else
+    // the sun and the light at the camera, without shadows: a proxy is only drawn far away
+    vec3 lightDir = normalize(-dirLight.direction);
+    vec3 result = dirLight.ambient * Color + dirLight.diffuse * max(dot(normal, lightDir), 0.0) * Color;
+    float distance = length(pointLight.position - FragPos);
+    float attenuation = 1.0 / (pointLight.constant + pointLight.linear * 2.0 * distance +
+                               pointLight.quadratic * 2.0 * (distance * distance));
+    float diff = max(dot(normal, normalize(pointLight.position - FragPos)), 0.0);
+    result += (pointLight.ambient * 0.05 + pointLight.diffuse * diff * 0.6) * Color * attenuation;
+    FragColor = vec4(result, 1.0);
+#endif
+}
@@ -0,0 +1,20 @@
+#version 330 core
+// the merged proxy of one HLOD cell, already in world space, see hlod.h
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec3 aColor;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec3 Color;
+
+uniform mat4 projection;
+uniform mat4 view;
+
+void main()
+{
+    FragPos = aPos;
+    Normal = aNormal;
+    Color = aColor;
+    gl_Position = projection * view * vec4(aPos, 1.0);
+}
@@ -0,0 +1,100 @@
+#version 330 core
+// the G-buffer outputs in the deferred path, the lit color otherwise
+#ifdef GBUFFER
+layout (location = 0) out vec4 gAlbedoSpec;
+layout (location = 1) out vec4 gNormalRoughness;
+#else
+out vec4 FragColor;
+#endif
+
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct PointLight {
+    vec3 position;
+
+    vec3 specular;
+    vec3 diffuse;
+    vec3 ambient;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+in vec2 FrameTexCoords[4];
+in vec3 WorldPos;
+flat in vec2 Frame;
+flat in vec2 FrameBlend;
+flat in vec3 ToCamera;
+flat in mat3 Rotation;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform float impostorRadius;
+uniform float framesPerSide;
+uniform sampler2D impostorAlbedo;
+uniform sampler2D impostorNormalDepth;
+
+uniform PointLight pointLight;
+uniform DirLight dirLight;
+
+vec2 OctWrap(vec2 v)
+{
+    return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// maps a unit vector onto the octahedron and unfolds it into [0, 1]^2
+vec2 EncodeOctahedral(vec3 n)
+{
+    n /= (abs(n.x) + abs(n.y) + abs(n.z));
+    n.xy = n.z >= 0.0 ? n.xy : OctWrap(n.xy);
+    return n.xy * 0.5 + 0.5;
+}
+
+void main()
+{
+    vec4 albedo = vec4(0.0);
+    vec4 normalDepth = vec4(0.0);
+    for (int i = 0; i < 4; i++) {
+        vec2 texCoords = FrameTexCoords[i];
+        // outside its frame a view sees nothing of the model
+        if (any(lessThan(texCoords, vec2(0.0))) || any(greaterThan(texCoords, vec2(1.0))))
+            continue;
+        vec2 corner = vec2(i & 1, i >> 1);
+        vec2 weights = mix(1.0 - FrameBlend, FrameBlend, corner);
+        vec2 atlasCoords = (Frame + corner + texCoords) / framesPerSide;
+        albedo += texture(impostorAlbedo, atlasCoords) * weights.x * weights.y;
+        normalDepth += texture(impostorNormalDepth, atlasCoords) * weights.x * weights.y;
+    }
+    if (albedo.a < 0.5)
+        discard;
+    // the frames are premultiplied by coverage
+    vec3 color = albedo.rgb / albedo.a;
+    vec3 normal = normalize(Rotation * (normalDepth.xyz / albedo.a * 2.0 - 1.0));
+    float depth = normalDepth.a / albedo.a * 2.0 - 1.0;
+
+    // from the quad onto the baked surface
+    vec4 clip = projection * view * vec4(WorldPos + ToCamera * depth * impostorRadius, 1.0);
+    gl_FragDepth = clip.z / clip.w * 0.5 + 0.5;
+
+#ifdef GBUFFER
+    gAlbedoSpec = vec4(color, 0.0);
+    // shininess 32 like the props, see gbuffer.fs
+    gNormalRoughness = vec4(EncodeOctahedral(normalize(mat3(view) * normal)), sqrt(2.0 / 34.0), 1.0);
+#else
+    // the sun and the light at the camera without shadows, the cascades end before the impostors start
+    vec3 lightDir = normalize(-dirLight.direction);
+    vec3 result = dirLight.ambient * color + dirLight.diffuse * max(dot(normal, lightDir), 0.0) * color;
+    float distance = length(pointLight.position - WorldPos);
+    float attenuation = 1.0 / (pointLight.constant + pointLight.linear * 2.0 * distance +
+                               pointLight.quadratic * 2.0 * (distance * distance));
+    result += (pointLight.ambient * 0.05 + pointLight.diffuse * max(dot(normal, ToCamera), 0.0) * 0.6) * color * attenuation;
+    FragColor = vec4(result, 1.0);
+#endif
+}
@@ -0,0 +1,70 @@
+#version 330 core
+// one camera facing quad per instance, see impostor.h
+layout (location = 0) in vec2 aCorner;
+layout (location = 1) in vec4 aPositionYaw;
+
+// the quad projected onto the four frames around the view direction
+out vec2 FrameTexCoords[4];
+out vec3 WorldPos;
+// lower left of the four frames and the bilinear weights between them
+flat out vec2 Frame;
+flat out vec2 FrameBlend;
+flat out vec3 ToCamera;
+flat out mat3 Rotation;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform vec3 impostorCamera;
+uniform vec3 impostorCenter;
+uniform float impostorRadius;
+uniform float framesPerSide;
+
+// hemi-octahedral encoding of a direction with y >= 0 into [0, 1]^2, rotated by 45 degrees so the whole
+// square is used
+vec2 EncodeHemiOctahedral(vec3 direction)
+{
+    vec2 p = direction.xz / (abs(direction.x) + abs(direction.y) + abs(direction.z));
+    return vec2(p.x + p.y, p.x - p.y) * 0.5 + 0.5;
+}
+
+// must match Impostor::frameDirection
+vec3 FrameDirection(vec2 frame)
+{
+    vec2 ab = frame / (framesPerSide - 1.0) * 2.0 - 1.0;
+    vec2 p = vec2(ab.x + ab.y, ab.x - ab.y) * 0.5;
+    return normalize(vec3(p.x, 1.0 - abs(p.x) - abs(p.y), p.y));
+}
+
+// right and up of a camera looking along -direction, like glm::lookAt in the bake
+void Basis(vec3 direction, out vec3 right, out vec3 up)
+{
+    vec3 worldUp = abs(direction.y) > 0.999 ? vec3(0.0, 0.0, -1.0) : vec3(0.0, 1.0, 0.0);
+    right = normalize(cross(worldUp, direction));
+    up = cross(direction, right);
+}
+
+void main()
+{
+    float s = sin(aPositionYaw.w);
+    float c = cos(aPositionYaw.w);
+    Rotation = mat3(c, 0.0, -s, 0.0, 1.0, 0.0, s, 0.0, c);
+    vec3 center = aPositionYaw.xyz + Rotation * impostorCenter;
+    ToCamera = normalize(impostorCamera - center);
+    vec3 right, up;
+    Basis(ToCamera, right, up);
+    WorldPos = center + (right * aCorner.x + up * aCorner.y) * impostorRadius;
+
+    // in the baked space the camera is never below the model
+    vec3 local = transpose(Rotation) * (WorldPos - center);
+    vec3 viewDirection = transpose(Rotation) * ToCamera;
+    viewDirection.y = max(viewDirection.y, 0.0);
+    vec2 grid = EncodeHemiOctahedral(normalize(viewDirection)) * (framesPerSide - 1.0);
+    Frame = min(floor(grid), vec2(framesPerSide - 2.0));
+    FrameBlend = grid - Frame;
+    for (int i = 0; i < 4; i++) {
+        vec3 frameRight, frameUp;
+        Basis(FrameDirection(Frame + vec2(i & 1, i >> 1)), frameRight, frameUp);
+        FrameTexCoords[i] = vec2(dot(local, frameRight), dot(local, frameUp)) / impostorRadius * 0.5 + 0.5;
+    }
+    gl_Position = projection * view * vec4(WorldPos, 1.0);
+}
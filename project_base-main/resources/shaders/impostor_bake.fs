@@ -0,0 +1,42 @@
+#version 330 core
+layout (location = 0) out vec4 Albedo;
+layout (location = 1) out vec4 NormalDepth;
+
+struct Material {
+    sampler2D texture_diffuse1;
+    sampler2D texture_specular1;
+    // layer and rect of the maps in the texture atlas, layer -1 when they are texture_diffuse1/specular1
+    float diffuseLayer;
+    vec4 diffuseRect;
+    float specularLayer;
+    vec4 specularRect;
+
+    float shininess;
+};
+
+in vec2 TexCoords;
+in vec3 Normal;
+in float Depth;
+
+uniform Material material;
+uniform sampler2DArray atlas;
+
+// maps packed by textureatlas.h are read from the array and wrapped by hand. the gradients are the ones of
+// the unwrapped coordinates, so the mip level doesn't jump at the seam
+vec4 MaterialTexture(sampler2D map, float layer, vec4 rect)
+{
+    if (layer < 0.0)
+        return texture(map, TexCoords);
+    return textureGrad(atlas, vec3(rect.xy + fract(TexCoords) * rect.zw, layer), dFdx(TexCoords) * rect.zw,
+                       dFdy(TexCoords) * rect.zw);
+}
+
+void main()
+{
+    vec4 albedo = MaterialTexture(material.texture_diffuse1, material.diffuseLayer, material.diffuseRect);
+    if (albedo.a < 0.5)
+        discard;
+    // alpha is coverage, the frames are cleared to 0 so filtered texels come out premultiplied
+    Albedo = vec4(albedo.rgb, 1.0);
+    NormalDepth = vec4(normalize(Normal) * 0.5 + 0.5, Depth);
+}
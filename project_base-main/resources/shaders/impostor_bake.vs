@@ -0,0 +1,25 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+
+out vec2 TexCoords;
+out vec3 Normal;
+out float Depth;
+
+// the bake transform with the bounding sphere's center moved to the origin
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 frameDirection;
+uniform float impostorRadius;
+
+void main()
+{
+    vec3 position = vec3(model * vec4(aPos, 1.0));
+    TexCoords = aTexCoords;
+    Normal = mat3(transpose(inverse(model))) * aNormal;
+    // towards the camera of the frame, 0.5 on the plane through the center
+    Depth = dot(position, frameDirection) / impostorRadius * 0.5 + 0.5;
+    gl_Position = projection * view * vec4(position, 1.0);
+}
@@ -0,0 +1,23 @@
+#version 330 core
+// composites the weighted blended transparency over the scene, blended with
+// GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA. see blending.fs
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec4 BrightColor;
+
+uniform sampler2D accumulation;
+uniform sampler2D weight;
+
+void main()
+{
+    // same pixel as the scene, whatever part of the target dynamic resolution uses
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    vec4 sum = texelFetch(accumulation, texel, 0);
+    float revealage = sum.a;
+    // nothing transparent here
+    if (revealage >= 1.0)
+        discard;
+    vec3 color = sum.rgb / max(texelFetch(weight, texel, 0).r, 1e-5);
+    FragColor = vec4(color, 1.0 - revealage);
+    float brightness = dot(color, vec3(0.2126, 0.7152, 0.0722));
+    BrightColor = vec4(brightness > 0.93 ? color : vec3(0.0), 1.0 - revealage);
+}
@@ -0,0 +1,26 @@
+// cascaded sun shadows, see shadows.h. included by every shader that receives them (Shader::injectIncludes),
+// only the SHADOWS variant samples the map
+uniform sampler2DArrayShadow shadowMap;
+uniform mat4 lightSpaceMatrices[3];
+uniform float cascadeSplits[3];
+
+// 1.0 = lit, 0.0 = in the sun's shadow
+float ShadowFactor(vec3 worldPos, float viewDepth, float bias)
+{
+#ifndef SHADOWS
+    return 1.0;
+#else
+    if (viewDepth > cascadeSplits[2])
+        return 1.0;
+    int cascade = viewDepth < cascadeSplits[0] ? 0 : (viewDepth < cascadeSplits[1] ? 1 : 2);
+    vec4 lightSpace = lightSpaceMatrices[cascade] * vec4(worldPos, 1.0);
+    vec3 projected = lightSpace.xyz / lightSpace.w * 0.5 + 0.5;
+    // 3x3 taps on top of the hardware 2x2 comparison filter
+    vec2 texel = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+    float lit = 0.0;
+    for (int x = -1; x <= 1; x++)
+        for (int y = -1; y <= 1; y++)
+            lit += texture(shadowMap, vec4(projected.xy + vec2(x, y) * texel, float(cascade), projected.z - bias));
+    return lit / 9.0;
+#endif
+}
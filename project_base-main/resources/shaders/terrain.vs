@@ -0,0 +1,63 @@
+#version 330 core
+// one terrain chunk: a gridSize x gridSize grid in [0, 1]^2, placed by chunk and lifted by the height map
+layout (location = 0) in vec2 aGrid;
+
+// for 1.advanced_lighting.fs
+out VS_OUT {
+    vec3 FragPos;
+    vec3 Normal;
+    vec2 TexCoords;
+} vs_out;
+// for 2.model_lighting_clustered.fs and gbuffer.fs
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+out vec3 ViewNormal;
+
+uniform mat4 projection;
+uniform mat4 view;
+
+uniform sampler2D heightMap;
+uniform vec2 terrainOrigin;     // world xz of the first height sample
+uniform float terrainSize;
+uniform float heightMapSize;    // samples per side
+uniform vec3 terrainCamera;
+uniform float gridSize;
+uniform float textureScale;
+
+uniform vec3 chunk;             // world xz of the corner, size
+uniform vec2 morphRange;        // distances where the vertices start and finish moving onto the coarser grid
+
+float Height(vec2 xz)
+{
+    // the first and last samples sit on the texel centers at the terrain's edges
+    vec2 uv = ((xz - terrainOrigin) / terrainSize * (heightMapSize - 1.0) + 0.5) / heightMapSize;
+    return textureLod(heightMap, uv, 0.0).r;
+}
+
+void main()
+{
+    vec2 xz = chunk.xy + aGrid * chunk.z;
+    float distance = length(terrainCamera - vec3(xz.x, Height(xz), xz.y));
+    float morph = clamp((distance - morphRange.x) / (morphRange.y - morphRange.x), 0.0, 1.0);
+    // odd vertices slide onto their even neighbour, at morph 1 the chunk matches the next level's grid
+    vec2 odd = fract(aGrid * gridSize * 0.5) * 2.0 / gridSize;
+    xz -= odd * chunk.z * morph;
+
+    vec3 position = vec3(xz.x, Height(xz), xz.y);
+    float texel = terrainSize / (heightMapSize - 1.0);
+    float left = Height(xz - vec2(texel, 0.0));
+    float right = Height(xz + vec2(texel, 0.0));
+    float back = Height(xz - vec2(0.0, texel));
+    float front = Height(xz + vec2(0.0, texel));
+    vec3 normal = normalize(vec3(left - right, 2.0 * texel, back - front));
+
+    FragPos = position;
+    Normal = normal;
+    TexCoords = xz * textureScale;
+    ViewNormal = mat3(view) * normal;
+    vs_out.FragPos = FragPos;
+    vs_out.Normal = Normal;
+    vs_out.TexCoords = TexCoords;
+    gl_Position = projection * view * vec4(position, 1.0);
+}
@@ -11,8 +11,30 @@
 
 #include <learnopengl/filesystem.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/shadervariants.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <learnopengl/textureatlas.h>
+#include <learnopengl/lights.h>
+#include <learnopengl/gbuffer.h>
+#include <learnopengl/clusters.h>
+#include <learnopengl/scene.h>
+#include <learnopengl/vegetation.h>
+#include <learnopengl/terrain.h>
+#include <learnopengl/impostor.h>
+#include <learnopengl/hlod.h>
+#include <learnopengl/staticbatch.h>
+#include <learnopengl/shadows.h>
+#include <learnopengl/rendertargets.h>
+#include <learnopengl/bloom.h>
+#include <learnopengl/framegraph.h>
+#include <learnopengl/dynamicresolution.h>
+#include <learnopengl/gpuprofiler.h>
+#include <learnopengl/profiler.h>
+#include <learnopengl/log.h>
+#include <learnopengl/framepacing.h>
+#include <learnopengl/headless.h>
+#include <learnopengl/camerapath.h>
 
 #include <iostream>
 
@@ -45,13 +67,39 @@ bool firstMouse = true;
 
 // timing
 float deltaTime = 0.0f;
-float lastFrame = 0.0f;
+// swap interval, frame cap and frames in flight, vsync toggled with V
+FramePacer framePacer;
+// flythrough recording (F5) and replay (F6), F7 starts a new segment while recording
+CameraPath cameraPath;
+const char *cameraPathFile = "camera_path.txt";
+// instanced grass over the whole lawn, tuned in the ImGui window
+Vegetation vegetation;
+// hills around the park out to the horizon, drawn in CDLOD chunks
+Terrain terrain;
+// cypresses on the hills, meshes up close and impostors further out
+Impostor forest;
+// the static props merged per cell, for when the camera is far from the park
+HLOD hlod;
+// the static props pre-transformed and merged per HLOD cell and material
+StaticBatcher staticBatcher;
+// vsync is turned off during a windowed replay, otherwise every frame takes a refresh interval
+int swapIntervalBeforeReplay = 1;
 bool blinn = false;
 bool hdr = false;
 bool hdrKeyPressed = false;
 bool bloom = false;
 bool bloomKeyPressed = false;
 float exposure = 1.0f;
+bool depthPrepass = false;
+// how the opaque scene gets lit, cycled with G
+enum RenderPath {
+    RENDER_PATH_FORWARD,
+    RENDER_PATH_DEFERRED,
+    RENDER_PATH_CLUSTERED
+};
+RenderPath renderPath = RENDER_PATH_FORWARD;
+bool shadows = false;
+bool dynamicResolution = false;
 
 
 // timing
@@ -116,48 +164,93 @@ void ProgramState::LoadFromFile(std::string filename) {
 
 ProgramState *programState;
 
-void DrawImGui(ProgramState *programState);
+void DrawImGui(ProgramState *programState, GpuProfiler &gpuProfiler);
+
+// switches on a render feature named on the command line, false for an unknown name
+bool enableFeature(const std::string &name);
+// the render toggles packed into the bits stored in camera paths
+unsigned int currentToggles();
+void applyToggles(unsigned int toggles);
+void startReplay();
+
+int main(int argc, char **argv) {
+    PROFILE_THREAD_NAME("main");
+    HeadlessOptions headless;
+    if (!headless.Parse(argc, argv))
+        return -1;
+    for (const std::string &feature : headless.features) {
+        if (!enableFeature(feature)) {
+            LOG_ERROR("unknown feature {}", feature);
+            return -1;
+        }
+    }
+
+    if (!headless.replayPath.empty()) {
+        if (!cameraPath.Load(headless.replayPath)) {
+            LOG_ERROR("Failed to load camera path {}", headless.replayPath);
+            return -1;
+        }
+        cameraPath.reportPrefix = headless.replayReportPrefix;
+        if (headless.enabled)
+            headless.frames = cameraPath.FrameCount();
+    }
 
-int main() {
-    // glfw: initialize and configure
-    // ------------------------------
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    GLFWwindow *window = NULL;
+    HeadlessContext headlessContext;
+    if (headless.enabled) {
+        if (!headlessContext.Create(headless.width, headless.height))
+            return -1;
+    } else {
+        // glfw: initialize and configure
+        // ------------------------------
+        glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
 #ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 
-    // glfw window creation
-    // --------------------
-    GLFWwindow *window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Park", NULL, NULL);
-    if (window == NULL) {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
+        // glfw window creation
+        // --------------------
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Park", NULL, NULL);
+        if (window == NULL) {
+            LOG_ERROR("Failed to create GLFW window");
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetScrollCallback(window, scroll_callback);
+        glfwSetKeyCallback(window, key_callback);
+        // tell GLFW to capture our mouse
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
-    glfwSetKeyCallback(window, key_callback);
-    // tell GLFW to capture our mouse
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
     // glad: load all OpenGL function pointers
     // ---------------------------------------
-    if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
-        std::cout << "Failed to initialize GLAD" << std::endl;
+    GLADloadproc loader = headless.enabled ? headlessContext.Loader() : (GLADloadproc) glfwGetProcAddress;
+    if (!gladLoadGLLoader(loader)) {
+        LOG_ERROR("Failed to initialize GLAD");
         return -1;
     }
+    // linked programs from earlier launches, every Shader below looks here first
+    ProgramBinaryCache::Instance().Init(loader, "shader_cache");
+    Shader::EnableParallelCompile(loader);
+    if (headless.enabled)
+        headlessContext.CreateFramebuffer();
+    // the composite pass draws here, the window or the offscreen target
+    unsigned int outputFramebuffer = headless.enabled ? headlessContext.framebuffer : 0;
 
     // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
     stbi_set_flip_vertically_on_load(true);
 
     programState = new ProgramState;
-    programState->LoadFromFile("resources/program_state.txt");
+    // headless runs always start from the default camera, so their images are reproducible
+    if (!headless.enabled)
+        programState->LoadFromFile("resources/program_state.txt");
     if (programState->ImGuiEnabled) {
         glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
     }
@@ -168,9 +261,11 @@ int main() {
     (void) io;
 
 
-
-    ImGui_ImplGlfw_InitForOpenGL(window, true);
-    ImGui_ImplOpenGL3_Init("#version 330 core");
+    // the glfw backend needs a window, headless runs go without ImGui
+    if (!headless.enabled) {
+        ImGui_ImplGlfw_InitForOpenGL(window, true);
+        ImGui_ImplOpenGL3_Init("#version 330 core");
+    }
 
     // configure global opengl state
     // -----------------------------
@@ -185,33 +280,74 @@ int main() {
     glCullFace(GL_FRONT);
     glFrontFace(GL_CW);
 
-    // build and compile shaders
-    // -------------------------
-    Shader ourShader("resources/shaders/2.model_lighting.vs", "resources/shaders/2.model_lighting.fs");
+    // build and compile shaders, the driver works on them while the models load
+    // -------------------------------------------------------------------------
+    // shaders with feature toggles are compiled once per combination, see shadervariants.h
+    ShaderVariants ourShaders("resources/shaders/2.model_lighting.vs", "resources/shaders/2.model_lighting.fs",
+                              {"SHADOWS", "ALPHA_TEST"}, [](Shader &s) { s.setInt("atlas", TextureAtlas::unit); });
     //Shader wallShader("resources/shaders/wall.vs", "resources/shaders/wall.fs");
     Shader shader("resources/shaders/cubemaps.vs", "resources/shaders/cubemaps.fs");
     Shader skyboxShader("resources/shaders/skybox.vs", "resources/shaders/skybox.fs");
     Shader blendingShader("resources/shaders/2.model_lighting.vs", "resources/shaders/blending.fs" );
-    Shader BlinnPhongshader("resources/shaders/1.advanced_lighting.vs", "resources/shaders/1.advanced_lighting.fs");
-    Shader travaShader("resources/shaders/3.1.blending.vs","resources/shaders/3.1.blending.fs");
-    Shader HdrShader("resources/shaders/hdr.vs", "resources/shaders/hdr.fs");
+    Shader oitResolveShader("resources/shaders/hdr.vs", "resources/shaders/oit_resolve.fs");
+    ShaderVariants BlinnPhongshaders("resources/shaders/1.advanced_lighting.vs", "resources/shaders/1.advanced_lighting.fs",
+                                     {"BLINN", "SHADOWS"});
+    Shader grassShader("resources/shaders/grass.vs", "resources/shaders/grass.fs");
+    ShaderVariants HdrShaders("resources/shaders/hdr.vs", "resources/shaders/hdr.fs", {"HDR", "BLOOM"}, [](Shader &s) {
+        s.setInt("hdrBuffer", 0);
+        s.setInt("bloomBlur", 1);
+    });
     Shader bloomShader("resources/shaders/bloom.vs", "resources/shaders/bloom.fs");
-    Shader blurShader("resources/shaders/blur.vs", "resources/shaders/blur.fs");
+    Shader bloomDownsampleShader("resources/shaders/hdr.vs", "resources/shaders/bloom_downsample.fs");
+    Shader bloomUpsampleShader("resources/shaders/hdr.vs", "resources/shaders/bloom_upsample.fs");
+    // ALPHA_TEST draws the cutouts into the shadow cascades from the full vertex layout and discards
+    ShaderVariants depthShaders("resources/shaders/depth_prepass.vs", "resources/shaders/depth_prepass.fs", {"ALPHA_TEST"},
+                                [](Shader &s) { s.setInt("atlas", TextureAtlas::unit); });
+    ShaderVariants gBufferShaders("resources/shaders/gbuffer.vs", "resources/shaders/gbuffer.fs", {"ALPHA_TEST"}, [](Shader &s) {
+        s.setFloat("material.shininess", 32.0f);
+        s.setInt("atlas", TextureAtlas::unit);
+    });
+    ShaderVariants deferredDirShaders("resources/shaders/hdr.vs", "resources/shaders/deferred_dir.fs", {"SHADOWS"}, [](Shader &s) {
+        s.setInt("gAlbedoSpec", 0);
+        s.setInt("gNormalRoughness", 1);
+        s.setInt("gDepth", 2);
+    });
+    Shader deferredLightShader("resources/shaders/deferred_light.vs", "resources/shaders/deferred_light.fs");
+    ShaderVariants clusteredShaders("resources/shaders/2.model_lighting.vs", "resources/shaders/2.model_lighting_clustered.fs",
+                                    {"SHADOWS", "ALPHA_TEST"}, [](Shader &s) { s.setInt("atlas", TextureAtlas::unit); });
+    // the terrain chunks come out of terrain.vs and are shaded like the floor was in each render path
+    ShaderVariants terrainForwardShaders("resources/shaders/terrain.vs", "resources/shaders/1.advanced_lighting.fs",
+                                         {"BLINN", "SHADOWS"});
+    ShaderVariants terrainClusteredShaders("resources/shaders/terrain.vs", "resources/shaders/2.model_lighting_clustered.fs",
+                                           {"SHADOWS"}, [](Shader &s) { s.setInt("atlas", TextureAtlas::unit); });
+    Shader terrainGBufferShader("resources/shaders/terrain.vs", "resources/shaders/gbuffer.fs");
+    Shader impostorBakeShader("resources/shaders/impostor_bake.vs", "resources/shaders/impostor_bake.fs");
+    ShaderVariants hlodShaders("resources/shaders/hlod.vs", "resources/shaders/hlod.fs", {"GBUFFER"});
+    ShaderVariants impostorShaders("resources/shaders/impostor.vs", "resources/shaders/impostor.fs", {"GBUFFER"}, [](Shader &s) {
+        s.setInt("impostorAlbedo", Impostor::albedoUnit);
+        s.setInt("impostorNormalDepth", Impostor::normalDepthUnit);
+    });
     // load models
     // -----------
+    // the props put their small maps into one texture array, the sun keeps its own textures
+    TextureAtlas textureAtlas;
 
-    Model ourModel("resources/objects/klupa3/uploads_files_793049_Bank-of-Wooden;OBJ;FBX/Bank-of-Wooden;OBJ;FBX/Bank_of_Wooden.obj");
+    Model ourModel("resources/objects/klupa3/uploads_files_793049_Bank-of-Wooden;OBJ;FBX/Bank-of-Wooden;OBJ;FBX/Bank_of_Wooden.obj",
+                   false, &textureAtlas);
     ourModel.SetShaderTextureNamePrefix("material.");
 
-    Model benchModel("resources/objects/klupa3/uploads_files_793049_Bank-of-Wooden;OBJ;FBX/Bank-of-Wooden;OBJ;FBX/Bank_of_Wooden.obj");
+    Model benchModel("resources/objects/klupa3/uploads_files_793049_Bank-of-Wooden;OBJ;FBX/Bank-of-Wooden;OBJ;FBX/Bank_of_Wooden.obj",
+                     false, &textureAtlas);
     benchModel.SetShaderTextureNamePrefix("material.");
 
     Model sunModel("resources/objects/sunce/Sun.obj");
     sunModel.SetShaderTextureNamePrefix("material.");
+    // see-through whatever its material says
+    sunModel.SetOpacity(0.6f);
 
 
     stbi_set_flip_vertically_on_load(false);
-    Model drvecaModel("resources/objects/park1/uploads_files_3749963_tree.obj");
+    Model drvecaModel("resources/objects/park1/uploads_files_3749963_tree.obj", false, &textureAtlas);
     drvecaModel.SetShaderTextureNamePrefix("material.");
     stbi_set_flip_vertically_on_load(true);
 
@@ -222,30 +358,21 @@ int main() {
     stbi_set_flip_vertically_on_load(true);
     */
 
-    Model swingModel("resources/objects/SWING2/untitled.obj");
+    Model swingModel("resources/objects/SWING2/untitled.obj", false, &textureAtlas);
     swingModel.SetShaderTextureNamePrefix("material.");
 
-    Model toboganModel("resources/objects/tobogan/tobogan.obj");
+    Model toboganModel("resources/objects/tobogan/tobogan.obj", false, &textureAtlas);
     toboganModel.SetShaderTextureNamePrefix("material.");
 
-    Model treeModel("resources/objects/tree5/uploads_files_2418161_ItalianCypress/ItalianCypress.obj");
+    Model treeModel("resources/objects/tree5/uploads_files_2418161_ItalianCypress/ItalianCypress.obj", false, &textureAtlas);
     treeModel.SetShaderTextureNamePrefix("material.");
+    textureAtlas.Build();
 
     /*
     unsigned int diffuseMap = loadTexture(FileSystem::getPath("resources/textures/bricks2.jpg").c_str());
     unsigned int normalMap  = loadTexture(FileSystem::getPath("resources/textures/bricks2_normal.jpg").c_str());
     unsigned int heightMap  = loadTexture(FileSystem::getPath("resources/textures/bricks2_disp.jpg").c_str());
     */
-    float planeVertices[] = {
-            // positions            // normals         // texcoords
-            20.0f, -0.5f, -20.0f,  0.0f, 1.0f, 0.0f,  20.0f, 20.0f, // Vertex 6
-            -20.0f, -0.5f, -20.0f,  0.0f, 1.0f, 0.0f,   0.0f, 20.0f, // Vertex 5
-            20.0f, -0.5f,  20.0f,  0.0f, 1.0f, 0.0f,  20.0f,  0.0f, // Vertex 4
-
-            -20.0f, -0.5f, -20.0f,  0.0f, 1.0f, 0.0f,   0.0f, 20.0f, // Vertex 3
-            -20.0f, -0.5f,  20.0f,  0.0f, 1.0f, 0.0f,   0.0f,  0.0f, // Vertex 2
-            20.0f, -0.5f,  20.0f,  0.0f, 1.0f, 0.0f,  20.0f,  0.0f  // Vertex 1
-    };
     float sideVertices[] = {
             // positions            // normals         // texcoords
 
@@ -257,23 +384,6 @@ int main() {
             20.0f,  4.0f,  20.0f,  1.0f, 0.0f, 0.0f,  20.0f, 1.0f,
             20.0f,  4.0f, -20.0f,  1.0f, 0.0f, 0.0f,  0.0f,  1.0f,
     };
-    float angleInDegrees = 90.0f;
-
-
-    float angleInRadians = glm::radians(angleInDegrees);
-
-// Kreiranje rotacione matrice oko Y ose za dati ugao
-    glm::mat4 rotationMatrix = glm::rotate(glm::mat4(1.0f), angleInRadians, glm::vec3(0.0f, 1.0f, 0.0f));
-
-// Rotiranje svaki verteks plana pomoću rotacione matrice
-    for (int i = 0; i < sizeof(planeVertices) / sizeof(float); i += 8) {
-        glm::vec4 vertex(planeVertices[i], planeVertices[i + 1], planeVertices[i + 2], 1.0f);
-        vertex = rotationMatrix * vertex;
-        planeVertices[i] = vertex.x;
-        planeVertices[i + 1] = vertex.y;
-        planeVertices[i + 2] = vertex.z;
-    }
-
     float skyboxVertices[] = {
             // positions
             -1.0f,  1.0f, -1.0f,
@@ -319,21 +429,6 @@ int main() {
             1.0f, -1.0f,  1.0f
     };
 
-    //ovaj kod za travu sam nasao u opengl repozitorijumu 4.advanced_opengl/3.1.blending_discard
-    float transparentVertices[] = {
-            // positions         // texture Coords (swapped y coordinates because texture is flipped upside down)
-            0.0f,  0.5f,  0.0f,  0.0f,  0.0f,
-            0.0f, -0.5f,  0.0f,  0.0f,  1.0f,
-            1.0f, -0.5f,  0.0f,  1.0f,  1.0f,
-
-            0.0f,  0.5f,  0.0f,  0.0f,  0.0f,
-            1.0f, -0.5f,  0.0f,  1.0f,  1.0f,
-            1.0f,  0.5f,  0.0f,  1.0f,  0.0f,
-            2.0f,  0.5f,  0.0f,  1.0f,  0.0f,
-            3.0f,  0.5f,  0.0f,  1.0f,  0.0f,
-            4.0f,  0.5f,  0.0f,  1.0f,  0.0f
-    };
-
     PointLight& pointLight = programState->pointLight;
     pointLight.position = glm::vec3(4.0f, 4.0, 0.0);
     pointLight.ambient = glm::vec3(0.1, 0.1, 0.1);
@@ -354,33 +449,6 @@ int main() {
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 
-    //transparen VAO
-    unsigned int transparentVAO, transparentVBO;
-    glGenVertexArrays(1, &transparentVAO);
-    glGenBuffers(1, &transparentVBO);
-    glBindVertexArray(transparentVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, transparentVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(transparentVertices), transparentVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    glBindVertexArray(0);
-
-    // plane VAO
-    unsigned int planeVAO, planeVBO;
-    glGenVertexArrays(1, &planeVAO);
-    glGenBuffers(1, &planeVBO);
-    glBindVertexArray(planeVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, planeVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(planeVertices), planeVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glBindVertexArray(0);
     // side VAO
 
     unsigned int sideVAO, sideVBO;
@@ -415,90 +483,105 @@ int main() {
             };
     unsigned int cubemapTexture = loadCubemap(faces);
 
-    unsigned int hdrFBO;
-    glGenFramebuffers(1, &hdrFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-
-    unsigned int colorBuffers[2];
-    glGenTextures(2, colorBuffers);
-    for (unsigned int i = 0; i < 2; i++)
-    {
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, colorBuffers[i], 0);
+    // HDR scene targets at the window's framebuffer size, which differs from SCR_WIDTH x SCR_HEIGHT on HiDPI screens
+    RenderTargets renderTargets(DEPTH24_FORMAT);
+    int framebufferWidth = headless.width, framebufferHeight = headless.height;
+    if (!headless.enabled)
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    renderTargets.Resize(framebufferWidth, framebufferHeight);
+    renderTargets.Update();
+
+    // bloom mip chain, six levels from half down to 1/64 resolution
+    BloomChain bloomChain(6);
+
+    // deferred shading
+    GBuffer gBuffer;
+    gBuffer.Create();
+
+    // evening lamp posts, lit only by the deferred path
+    vector<LocalLight> lampLights = MakeLampPosts(6, 6, 6.0f);
+
+    // one screen space quad per light, the rectangle and light data come in as instance attributes
+    float lightCorners[] = {
+            0.0f, 0.0f,
+            1.0f, 0.0f,
+            0.0f, 1.0f,
+            1.0f, 1.0f
+    };
+    const int lightInstanceFloats = 16;
+    unsigned int deferredLightVAO, deferredLightCornerVBO, deferredLightInstanceVBO;
+    glGenVertexArrays(1, &deferredLightVAO);
+    glGenBuffers(1, &deferredLightCornerVBO);
+    glGenBuffers(1, &deferredLightInstanceVBO);
+    glBindVertexArray(deferredLightVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, deferredLightCornerVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(lightCorners), lightCorners, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glBindBuffer(GL_ARRAY_BUFFER, deferredLightInstanceVBO);
+    for (unsigned int i = 0; i < 4; i++) {
+        glEnableVertexAttribArray(1 + i);
+        glVertexAttribPointer(1 + i, 4, GL_FLOAT, GL_FALSE, lightInstanceFloats * sizeof(float), (void*)(i * 4 * sizeof(float)));
+        glVertexAttribDivisor(1 + i, 1);
     }
-
-    unsigned int rboDepth;
-    glGenRenderbuffers(1, &rboDepth);
-    glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, SCR_WIDTH, SCR_HEIGHT);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
-    unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
-    glDrawBuffers(2, attachments);
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cout << "Framebuffer not complete!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    // preparing blur.
-    unsigned int pingpongFBO[2];
-    unsigned int pingpongColorbuffers[2];
-    glGenFramebuffers(2, pingpongFBO);
-    glGenTextures(2, pingpongColorbuffers);
-    for (unsigned int i = 0; i < 2; i++)
-    {
-        glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pingpongColorbuffers[i], 0);
-
-        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-            std::cout << "Framebuffer not complete!" << std::endl;
+    glBindVertexArray(0);
+    vector<float> lightInstances;
+
+    // clustered forward: a dense field of small lamps, every second one is a spot pointing down
+    vector<LocalLight> clusteredLights = MakeLampPosts(16, 16, 2.5f, 1.2f, 2.0f);
+    for (unsigned int i = 0; i < clusteredLights.size(); i += 2) {
+        clusteredLights[i].radius = 3.0f;
+        clusteredLights[i].cosInnerCutOff = glm::cos(glm::radians(25.0f));
+        clusteredLights[i].cosOuterCutOff = glm::cos(glm::radians(35.0f));
     }
-
-    vector<glm::vec3> vegetation
-            {
-                    glm::vec3(-1.5f, 0.0f, -0.48f),
-                    glm::vec3( 1.5f, 0.0f, 0.51f),
-                    glm::vec3( 0.0f, 0.0f, 0.7f),
-                    glm::vec3(-0.3f, 0.0f, -2.3f),
-                    glm::vec3 (0.5f, 0.0f, -0.6f),
-                    glm::vec3(2,0,3),
-                    glm::vec3(2,0,4),
-                    glm::vec3(2,0,2),
-                    glm::vec3(2,0,0),
-
-
-            };
+    ClusterGrid clusterGrid(0.1f, 100.0f);
+    clusterGrid.SetLights(clusteredLights);
 
     // shader configuration
     // --------------------
+    // variants for the toggles the program starts with, the others are built the first time they're switched on
+    unsigned int startShadows = ShaderVariants::Mask({shadows});
+    Shader::FinishAll({&ourShaders.Submit(startShadows), &shader, &skyboxShader, &blendingShader, &oitResolveShader,
+                       &BlinnPhongshaders.Submit(ShaderVariants::Mask({blinn, shadows})), &grassShader,
+                       &HdrShaders.Submit(ShaderVariants::Mask({hdr, bloom})), &bloomShader, &bloomDownsampleShader,
+                       &bloomUpsampleShader, &depthShaders.Submit(0), &gBufferShaders.Submit(0), &deferredDirShaders.Submit(startShadows),
+                       &deferredLightShader, &clusteredShaders.Submit(startShadows),
+                       &terrainForwardShaders.Submit(ShaderVariants::Mask({blinn, shadows})),
+                       &terrainClusteredShaders.Submit(startShadows), &terrainGBufferShader, &impostorBakeShader,
+                       &impostorShaders.Submit(ShaderVariants::Mask({renderPath == RENDER_PATH_DEFERRED})),
+                       &hlodShaders.Submit(ShaderVariants::Mask({renderPath == RENDER_PATH_DEFERRED})),
+                       &ourShaders.Submit(ShaderVariants::Mask({shadows, true})),
+                       &clusteredShaders.Submit(ShaderVariants::Mask({shadows, true})),
+                       &gBufferShaders.Submit(ShaderVariants::Mask({true})),
+                       &depthShaders.Submit(ShaderVariants::Mask({true}))});
+    LOG_INFO("program binary cache: {} hits, {} misses", ProgramBinaryCache::Instance().hits, ProgramBinaryCache::Instance().misses);
+    Shader &depthPrepassShader = depthShaders.Get(0);
+    Shader &alphaTestedDepthShader = depthShaders.Get(ShaderVariants::Mask({true}));
     shader.use();
     shader.setInt("texture1", 0);
 
     skyboxShader.use();
     skyboxShader.setInt("skybox", 0);
 
-    //HdrShader.use();
-    //HdrShader.setInt("hdrBuffer", 0);
-    //HdrShader.setInt("bloomBlur", 1);
-
-    blurShader.use();
-    blurShader.setInt("image", 0);
-
     bloomShader.use();
     bloomShader.setInt("scene", 0);
     bloomShader.setInt("bloomBlur", 1);
 
-    BlinnPhongshader.use();
-    BlinnPhongshader.setInt("blinn-phong", 0);
+    blendingShader.use();
+    blendingShader.setInt("atlas", TextureAtlas::unit);
+
+    oitResolveShader.use();
+    oitResolveShader.setInt("accumulation", 0);
+    oitResolveShader.setInt("weight", 1);
+
+    terrainGBufferShader.use();
+    terrainGBufferShader.setFloat("material.shininess", 32.0f);
+    terrainGBufferShader.setInt("atlas", TextureAtlas::unit);
+
+    deferredLightShader.use();
+    deferredLightShader.setInt("gAlbedoSpec", 0);
+    deferredLightShader.setInt("gNormalRoughness", 1);
+    deferredLightShader.setInt("gDepth", 2);
 
     /*
     wallShader.use();
@@ -506,154 +589,197 @@ int main() {
     wallShader.setInt("normalMap", 1);
     wallShader.setInt("depthMap", 2);
     */
+    // the props never move, so their model matrices are built once. each mesh draws in the bucket of its
+    // material class
+    vector<SceneObject> opaqueObjects;
+
+    // render the bench model
+    glm::mat4 model = glm::mat4(1.0f);
+    model = glm::translate(model,
+                           glm::vec3 (3,-0.48,1)); // translate it down so it's at the center of the scene
+    model = glm::scale(model, glm::vec3(0.005,0.005,0.005));
+    model = glm::rotate(model, glm::radians(-20.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    // it's a bit too big for our scene, so scale it down
+    opaqueObjects.push_back(MakeSceneObject(&ourModel, model));
+
+    // render another bench model
+    glm::mat4 model0 = glm::mat4(1.0f);
+    model0 = glm::translate(model0,
+                            glm::vec3 (5.750,-0.48,1.975)); // translate it down so it's at the center of the scene
+    model0 = glm::scale(model0, glm::vec3(0.005,0.005,0.005));
+    model0 = glm::rotate(model0, glm::radians(-20.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    // it's a bit too big for our scene, so scale it down
+    opaqueObjects.push_back(MakeSceneObject(&ourModel, model0));
+
+    // Model drveta koji renderujemo
+
+    glm::mat4 model1 = glm::mat4(1.0f);
+    model1 = glm::translate(model1,
+                            glm::vec3 (3,-0.43,3)); // translate it down so it's at the center of the scene
+    model1 = glm::scale(model1, glm::vec3(0.25,0.2,0.25));
+    model1 = glm::rotate(model1, glm::radians(-45.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    // it's a bit too big for our scene, so scale it down
+    opaqueObjects.push_back(MakeSceneObject(&treeModel, model1));
+
+    //Model logorske vatre koji renderujemo
+
+
+    glm::mat4 model3 = glm::mat4(1.0f);
+    model3 = glm::translate(model3,
+                            glm::vec3 (4,-0.55,2)); // translate it down so it's at the center of the scene
+    model3 = glm::scale(model3, glm::vec3(0.5,0.5,0.5));
+    //model3 = glm::rotate(model3, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    //model3 = glm::rotate(model3, glm::radians(-5.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+    //model3 = glm::rotate(model3, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    // it's a bit too big for our scene, so scale it down
+    opaqueObjects.push_back(MakeSceneObject(&drvecaModel, model3));
+
+
+    //tobogan
+    glm::mat4 modelTobogan = glm::mat4(1.0f);
+    modelTobogan = glm::translate(modelTobogan,
+                                  glm::vec3 (-2.50,-0.45,3.0)); // translate it down so it's at the center of the scene
+    modelTobogan = glm::scale(modelTobogan, glm::vec3(0.5,0.5,0.5));
+
+    // it's a bit too big for our scene, so scale it down
+    opaqueObjects.push_back(MakeSceneObject(&toboganModel, modelTobogan));
+
+
+    glm::mat4 modelSwing = glm::mat4(1.0f);
+    modelSwing = glm::translate(modelSwing ,
+                                 glm::vec3 (0,-0.6,1.2)); // translate it down so it's at the center of the scene
+    modelSwing  = glm::scale(modelSwing , glm::vec3(0.23,0.23,0.27));
+
+
+    // it's a bit too big for our scene, so scale it down
+    // the swing is the only prop that may move, its shadow is redrawn every frame
+    opaqueObjects.push_back(MakeSceneObject(&swingModel, modelSwing, false));
+    hlod.Build(opaqueObjects, textureAtlas);
+    // nothing picks props, the CPU copies of their meshes can go
+    staticBatcher.Build(opaqueObjects, false);
+
+    // everything that can cast a shadow: the props, the floor and the wall
+    glm::vec3 sceneMin(-20.0f, -4.0f, -20.0f), sceneMax(20.0f, 4.0f, 20.0f);
+    for (const SceneObject& object : opaqueObjects) {
+        sceneMin = glm::min(sceneMin, object.boundsMin);
+        sceneMax = glm::max(sceneMax, object.boundsMax);
+    }
+
+    // grass in patches over the floor, none under the props
+    DensityMap grassDensity(80, 80, glm::vec2(-19.5f, -19.5f), glm::vec2(19.5f, 19.5f));
+    grassDensity.Noise(7, 10, 0.15f);
+    for (const SceneObject& object : opaqueObjects)
+        grassDensity.Clear(object.boundsMin, object.boundsMax, 0.2f);
+    vegetation.Build(grassDensity, -0.5f);
+    // a square kilometer of it, flat at the floor's height under the park so the props and the grass stay put
+    terrain.Generate(1024, 1024.0f, 7, 21.0f, 30.0f, -0.5f, 40.0f, 3);
+    // the park's cypress at the park's scale, scattered outside the walls as far as the far plane reaches
+    forest.Bake(treeModel, glm::scale(glm::mat4(1.0f), glm::vec3(0.25f, 0.2f, 0.25f)), impostorBakeShader);
+    std::mt19937 forestRandom(11);
+    std::uniform_real_distribution<float> forestPosition(-95.0f, 95.0f), forestYaw(0.0f, 6.2831853f);
+    while (forest.Instances() < 400) {
+        float x = forestPosition(forestRandom), z = forestPosition(forestRandom);
+        if (std::max(std::fabs(x), std::fabs(z)) < 24.0f)
+            continue;
+        // a little into the ground, the hills slope under the trunk
+        forest.Add(glm::vec3(x, terrain.HeightAt(x, z) - 0.1f, z), forestYaw(forestRandom));
+    }
+    forest.Build();
+    CascadedShadowMap shadowMap;
+
     // draw in wireframe
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
     glm::vec3 lightPos(0.0f, 4.0f, 3.0f);
+
+    // per frame state, the frame graph passes read it through their references
+    glm::mat4 view, projection, model2;
+    glm::vec3 sunDirection, sunDiffuse;
+    bool sunUp = false;
+    // drives the wind, follows the replay clock like the sun
+    float animationTime = 0.0f;
+    int width = 0, height = 0;
+    // the scene is drawn into the lower left renderWidth x renderHeight part of the screen sized targets
+    int renderWidth = 0, renderHeight = 0;
+    glm::vec2 renderUvScale(1.0f);
+    Shader *currentLitShader = nullptr;
+    // the ALPHA_TEST variant of the lit shader
+    Shader *currentAlphaTestedShader = nullptr;
+    // the clustered variant of the terrain, null in the other paths
+    Shader *currentTerrainShader = nullptr;
+    // the impostor variant for the current path
+    Shader *currentImpostorShader = nullptr;
+    Shader *currentHlodShader = nullptr;
+    // SHADOWS bit of the lit shader variants, shadows only show while the sun is up
+    unsigned int shadowVariant = 0;
+
+    // holds 16 ms of GPU time per frame by rendering the scene at 50% to 100% of the window size
+    DynamicResolution resolutionScaler(16.0f, 0.5f, 1.0f);
+    // per pass timings, shown in the ImGui overlay (F1)
+    GpuProfiler gpuProfiler;
+
+    // rebuilt only when one of the toggles that changes the pass list or the window size changes
+    FrameGraph frameGraph;
+    int frameGraphConfiguration = -1;
+    int frameGraphRenderWidth = 0, frameGraphRenderHeight = 0;
+    // last logged hdr/bloom/exposure, the status line is logged only when one of them changes
+    bool loggedHdr = !hdr, loggedBloom = bloom;
+    float loggedExposure = exposure;
     // render loop
     // -----------
-    while (!glfwWindowShouldClose(window)) {
+    int frameIndex = 0;
+    FrameStatistics frameStatistics;
+    while (headless.enabled ? frameIndex < headless.warmupFrames + headless.frames : !glfwWindowShouldClose(window)) {
+        PROFILE_ZONE("frame");
         // per-frame time logic
         // --------------------
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
-
-        // input
-        // -----
-        processInput(window);
-
+        auto frameStart = std::chrono::steady_clock::now();
+        float currentFrame;
+        if (headless.enabled) {
+            // fixed clock, the sun and the swing are at the same place in every run
+            currentFrame = frameIndex / 60.0f;
+            deltaTime = 1.0f / 60.0f;
+        } else {
+            currentFrame = glfwGetTime();
+            deltaTime = framePacer.BeginFrame();
 
-        // render
-        // ------
-        glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
-        glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-
-        // don't forget to enable shader before setting uniforms
-        ourShader.use();
-        // Postavite pointLight.position na poziciju kamere
-        ourShader.setVec3("pointLight.position", programState->camera.Position);
-        ourShader.setVec3("pointLight.ambient", pointLight.ambient);
-        ourShader.setVec3("pointLight.diffuse", pointLight.diffuse);
-        ourShader.setVec3("pointLight.specular", pointLight.specular);
-        ourShader.setFloat("pointLight.constant", pointLight.constant);
-        ourShader.setFloat("pointLight.linear", pointLight.linear);
-        ourShader.setFloat("pointLight.quadratic", pointLight.quadratic);
-
-        ourShader.setVec3("viewPosition", programState->camera.Position);
-        ourShader.setFloat("material.shininess", 32.0f);
-        ourShader.setVec3("material.specular", 0.0f, 0.0f, 0.0f);
-        ourShader.setBool("blinn",false);
-
-        ourShader.setVec3("spotLight.position", programState->camera.Position );
-        ourShader.setVec3("spotLight.direction", programState->camera.Front);
-        ourShader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-        ourShader.setVec3("spotLight.diffuse", 0.0f, 0.0f, 0.0f);
-        ourShader.setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
-        ourShader.setFloat("spotLight.constant", 1.0f);
-        ourShader.setFloat("spotLight.linear", 0.09);
-        ourShader.setFloat("spotLight.quadratic", 0.032);
-        ourShader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-        ourShader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
-
-
-        ourShader.setVec3("dirLight.position", glm::vec3(1.0,2.0,3.0));
-        ourShader.setVec3("dirLight.direction", glm::vec3(0.0f,-1.0f,0.0f));
-        ourShader.setVec3("dirLight.ambient", glm::vec3(0.1f,0.1f,0.1f));
-        ourShader.setVec3("dirLight.diffuse", glm::vec3(0.1f,0.1f,0.1f));
-        ourShader.setVec3("dirLight.specular", glm::vec3(0.1f,0.1f,0.1f));
+            // input
+            // -----
+            processInput(window);
+        }
 
-        // view/projection transformations
-        glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),
-                                                (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = programState->camera.GetViewMatrix();
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
-
-
-        // render the bench model
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model,
-                               glm::vec3 (3,-0.48,1)); // translate it down so it's at the center of the scene
-        model = glm::scale(model, glm::vec3(0.005,0.005,0.005));
-        model = glm::rotate(model, glm::radians(-20.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        // it's a bit too big for our scene, so scale it down
-        ourShader.setMat4("model", model);
-        ourModel.Draw(ourShader);
-
-        // render another bench model
-        glm::mat4 model0 = glm::mat4(1.0f);
-        model0 = glm::translate(model0,
-                                glm::vec3 (5.750,-0.48,1.975)); // translate it down so it's at the center of the scene
-        model0 = glm::scale(model0, glm::vec3(0.005,0.005,0.005));
-        model0 = glm::rotate(model0, glm::radians(-20.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        // it's a bit too big for our scene, so scale it down
-        ourShader.setMat4("model", model0);
-        ourModel.Draw(ourShader);
-
-        // Model drveta koji renderujemo
-
-        glm::mat4 model1 = glm::mat4(1.0f);
-        model1 = glm::translate(model1,
-                                glm::vec3 (3,-0.43,3)); // translate it down so it's at the center of the scene
-        model1 = glm::scale(model1, glm::vec3(0.25,0.2,0.25));
-        model1 = glm::rotate(model1, glm::radians(-45.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        // it's a bit too big for our scene, so scale it down
-        ourShader.setMat4("model", model1);
-        treeModel.Draw(ourShader);
-
-        //Model logorske vatre koji renderujemo
-
-
-        glm::mat4 model3 = glm::mat4(1.0f);
-        model3 = glm::translate(model3,
-                                glm::vec3 (4,-0.55,2)); // translate it down so it's at the center of the scene
-        model3 = glm::scale(model3, glm::vec3(0.5,0.5,0.5));
-        //model3 = glm::rotate(model3, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        //model3 = glm::rotate(model3, glm::radians(-5.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        //model3 = glm::rotate(model3, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        // it's a bit too big for our scene, so scale it down
-        ourShader.setMat4("model", model3);
-        drvecaModel.Draw(ourShader);
-
-
-        //tobogan
-        glm::mat4 modelTobogan = glm::mat4(1.0f);
-        modelTobogan = glm::translate(modelTobogan,
-                                      glm::vec3 (-2.50,-0.45,3.0)); // translate it down so it's at the center of the scene
-        modelTobogan = glm::scale(modelTobogan, glm::vec3(0.5,0.5,0.5));
-
-        // it's a bit too big for our scene, so scale it down
-        ourShader.setMat4("model", modelTobogan);
-        toboganModel.Draw(ourShader);
-
-
-        glm::mat4 modelSwing = glm::mat4(1.0f);
-        modelSwing = glm::translate(modelSwing ,
-                                     glm::vec3 (0,-0.6,1.2)); // translate it down so it's at the center of the scene
-        modelSwing  = glm::scale(modelSwing , glm::vec3(0.23,0.23,0.27));
-
-
-        // it's a bit too big for our scene, so scale it down
-        ourShader.setMat4("model", modelSwing);
-        swingModel.Draw(ourShader);
-
-
-        //blending
-        blendingShader.use();
-        blendingShader.setVec3("viewPosition", programState->camera.Position);
-        blendingShader.setFloat("material.shininess", 32.0f);
-        blendingShader.setMat4("projection", projection);
-        blendingShader.setMat4("view", view);
-        blendingShader.setVec3("dirLight.direction", glm::vec3(-0.547f, -0.727f, 0.415f));
-        blendingShader.setVec3("dirLight.ambient", glm::vec3(0.35f));
-        blendingShader.setVec3("dirLight.diffuse", glm::vec3(0.4f));
-        blendingShader.setVec3("dirLight.specular", glm::vec3(0.2f));
+        if (!headless.replayPath.empty() && frameIndex == (headless.enabled ? headless.warmupFrames : 0))
+            startReplay();
+        if (cameraPath.Replaying()) {
+            // the path decides the camera, the animation time and the toggles, at a fixed step
+            unsigned int toggles;
+            if (cameraPath.ReplayFrame(programState->camera, currentFrame, toggles)) {
+                applyToggles(toggles);
+                deltaTime = CameraPath::fixedStep;
+            } else if (!headless.enabled) {
+                framePacer.swapInterval = swapIntervalBeforeReplay;
+            }
+        } else if (!headless.enabled) {
+            cameraPath.Record(glfwGetTime(), currentFrame, programState->camera, currentToggles());
+        }
+        animationTime = currentFrame;
 
+        // recreate the screen sized targets after the window was resized
+        bool resized;
+        {
+            PROFILE_ZONE("resize targets");
+            if (!headless.enabled)
+                glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+            renderTargets.Resize(framebufferWidth, framebufferHeight);
+            resized = renderTargets.Update();
+            width = renderTargets.width;
+            height = renderTargets.height;
+            renderWidth = std::max(1, (int) (width * resolutionScaler.scale));
+            renderHeight = std::max(1, (int) (height * resolutionScaler.scale));
+            renderUvScale = glm::vec2((float) renderWidth / width, (float) renderHeight / height);
+        }
 
         // Model Sunca koji renderujemo
-        glm::mat4 model2 = glm::mat4(1.0f);
+        model2 = glm::mat4(1.0f);
         model2 = glm::translate(model2, glm::vec3(10, 25, -10)); // translate it down so it's at the center of the scene
         model2 = glm::rotate(model2, glm::radians(-45.0f), glm::vec3(0.0f, 1.0f, 0.0f));
 
@@ -678,156 +804,718 @@ int main() {
         model2 = translateBack * scaleMatrix * selfRotationMatrix * rotationMatrix * translateToOrigin;
 
         model2 = glm::scale(model2, glm::vec3(0.05,0.05,0.05));
-        // it's a bit too big for our scene, so scale it down
-        ourShader.setMat4("model", model2);
-        sunModel.Draw(ourShader);
-
-        BlinnPhongshader.use();
-
-        BlinnPhongshader.setMat4("projection", projection);
-        BlinnPhongshader.setMat4("view", view);
-        // set light uniforms
-
-        BlinnPhongshader.setVec3("viewPos", programState->camera.Position);
-        BlinnPhongshader.setVec3("lightPos", lightPos);
-        BlinnPhongshader.setInt("blinn", blinn);
-        // floor
-        glBindVertexArray(planeVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, floorTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        //zid
-
-        glBindVertexArray(sideVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, sideTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
-
-
-        travaShader.use();
-        travaShader.setMat4("projection", projection);
-        travaShader.setMat4("view", view);
-
-        glDisable(GL_CULL_FACE);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, GrassTexture);
-        glBindVertexArray(transparentVAO);
-        glBindTexture(GL_TEXTURE_2D, GrassTexture);
-        for (unsigned int i = 0; i < vegetation.size(); i++)
-        {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, vegetation[i]);
-            shader.setMat4("model", model);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
+
+        // the sun shines from its model's position towards the middle of the park,
+        // once it sets there is no direct sunlight and nothing to shadow
+        glm::vec3 sunPosition = glm::vec3(model2 * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+        sunDirection = glm::normalize(-sunPosition);
+        sunUp = sunDirection.y < 0.0f;
+        sunDiffuse = sunUp ? glm::vec3(0.3f) : glm::vec3(0.0f);
+
+
+        // render
+        // ------
+        // the clustered variant takes the same uniforms as 2.model_lighting.fs plus the cluster data
+        shadowVariant = ShaderVariants::Mask({shadows && sunUp});
+        currentLitShader = &(renderPath == RENDER_PATH_CLUSTERED ? clusteredShaders : ourShaders).Get(shadowVariant);
+        currentAlphaTestedShader = &(renderPath == RENDER_PATH_CLUSTERED ? clusteredShaders : ourShaders)
+                .Get(shadowVariant | ShaderVariants::Mask({false, true}));
+        // view/projection transformations
+        projection = glm::perspective(glm::radians(programState->camera.Zoom),
+                                                renderTargets.Aspect(), 0.1f, 100.0f);
+        view = programState->camera.GetViewMatrix();
+        if (shadows && sunUp) {
+            PROFILE_ZONE("cascade update");
+            // the casters are drawn by the shadows pass of the frame graph
+            shadowMap.Update(sunDirection, view, glm::radians(programState->camera.Zoom), renderTargets.Aspect(), 0.1f, sceneMin, sceneMax);
         }
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, GrassTexture);
-        /*
-        wallShader.use();
-        wallShader.setMat4("projection", projection);
-        wallShader.setMat4("view", view);
-        wallShader.setVec3("viewPos", programState->camera.Position);
-        model = glm::mat4(1.0f);
-        wallShader.setMat4("model", model);
-        wallShader.setFloat("height_scale", heightScale);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, diffuseMap);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, normalMap);
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, heightMap);
-
-        renderWall();
-        glDisable(GL_CULL_FACE);
-        */
-        //poslednji skybox
-        skyboxShader.use();
-        view[3][0] = 0; // Postavljam x translaciju na nulu
-        view[3][1] = 0; // Postavljam y translaciju na nulu
-        view[3][2] = 0; // postavljam z translaciju na nulu
-        view[3][3] = 0;
-        skyboxShader.setMat4("view", view);
-        skyboxShader.setMat4("projection", projection);
-
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glDepthFunc(GL_LESS); // set depth function back to default
-
-        // blur
-        bool horizontal = true, first_iteration = true;
-        unsigned int amount = 10;
-        blurShader.use();
-        for (unsigned int i = 0; i < amount; i++)
-        {
-            glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
-            blurShader.setInt("horizontal", horizontal);
-            glBindTexture(GL_TEXTURE_2D, first_iteration ? colorBuffers[1] : pingpongColorbuffers[!horizontal]);  // bind texture of other framebuffer (or scene if first iteration)
-            renderQuad();
-            horizontal = !horizontal;
-            if (first_iteration)
-                first_iteration = false;
+        if (renderPath == RENDER_PATH_CLUSTERED) {
+            PROFILE_ZONE("cluster build");
+            clusterGrid.Build(view, projection);
+        }
+        forest.Select(projection, view, programState->camera.Position);
+        hlod.Select(projection, view, programState->camera.Position);
+        staticBatcher.Select(projection, view, hlod);
+        // in the clustered path the terrain shades with the same fragment shader and takes the same uniforms,
+        // the impostors, the HLOD proxies and the cutouts read the lights from them too. the lit shader goes last and stays bound
+        currentTerrainShader = renderPath == RENDER_PATH_CLUSTERED ? &terrainClusteredShaders.Get(shadowVariant) : nullptr;
+        currentImpostorShader = &impostorShaders.Get(ShaderVariants::Mask({renderPath == RENDER_PATH_DEFERRED}));
+        currentHlodShader = &hlodShaders.Get(ShaderVariants::Mask({renderPath == RENDER_PATH_DEFERRED}));
+        for (Shader *lit : {currentTerrainShader, currentImpostorShader, currentHlodShader, currentAlphaTestedShader, currentLitShader}) {
+            if (!lit)
+                continue;
+            Shader &litShader = *lit;
+            // don't forget to enable shader before setting uniforms
+            litShader.use();
+            // Postavite pointLight.position na poziciju kamere
+            litShader.setVec3("pointLight.position", programState->camera.Position);
+            litShader.setVec3("pointLight.ambient", pointLight.ambient);
+            litShader.setVec3("pointLight.diffuse", pointLight.diffuse);
+            litShader.setVec3("pointLight.specular", pointLight.specular);
+            litShader.setFloat("pointLight.constant", pointLight.constant);
+            litShader.setFloat("pointLight.linear", pointLight.linear);
+            litShader.setFloat("pointLight.quadratic", pointLight.quadratic);
+
+            litShader.setVec3("viewPosition", programState->camera.Position);
+            litShader.setFloat("material.shininess", 32.0f);
+            litShader.setVec3("material.specular", 0.0f, 0.0f, 0.0f);
+
+            litShader.setVec3("spotLight.position", programState->camera.Position );
+            litShader.setVec3("spotLight.direction", programState->camera.Front);
+            litShader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
+            litShader.setVec3("spotLight.diffuse", 0.0f, 0.0f, 0.0f);
+            litShader.setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
+            litShader.setFloat("spotLight.constant", 1.0f);
+            litShader.setFloat("spotLight.linear", 0.09);
+            litShader.setFloat("spotLight.quadratic", 0.032);
+            litShader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
+            litShader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
+
+
+            litShader.setVec3("dirLight.direction", sunDirection);
+            litShader.setVec3("dirLight.ambient", glm::vec3(0.1f,0.1f,0.1f));
+            litShader.setVec3("dirLight.diffuse", sunDiffuse);
+            litShader.setVec3("dirLight.specular", glm::vec3(0.1f,0.1f,0.1f));
+
+            litShader.setMat4("projection", projection);
+            litShader.setMat4("view", view);
+
+            // the shadow array is always bound, a sampler2DArrayShadow must never alias the 2D texture on unit 0
+            shadowMap.Bind(litShader, 7);
+
+            if (renderPath == RENDER_PATH_CLUSTERED)
+                // units above the ones the meshes use for their material textures
+                clusterGrid.Bind(litShader, 8, renderWidth, renderHeight);
         }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
 
-        // --------------------------------------------------------------------------------------------------------------------------
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        //bloomShader.use();
-        HdrShader.use();
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[0]);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[!horizontal]);
-        HdrShader.setBool("hdr", hdr);
-        HdrShader.setInt("bloom", bloom);
-//        bloomShader.setInt("bloom", bloom);
-//        bloomShader.setFloat("exposure", exposure);
-        HdrShader.setFloat("exposure", exposure);
-        renderQuad();
 
-        std::cout << "hdr: " << (hdr ? "on" : "off") << std::endl;
-        std::cout << "bloom: " << (bloom ? "on" : "off") << " | exposure: " << exposure << std::endl;
+        // the pass list only depends on these toggles, passes whose output is unused are culled by Compile
+        int configuration = (bloom ? 1 : 0) | (shadows && sunUp ? 2 : 0) | (depthPrepass ? 4 : 0) | (renderPath << 3);
+        if (resized || configuration != frameGraphConfiguration ||
+            renderWidth != frameGraphRenderWidth || renderHeight != frameGraphRenderHeight) {
+            PROFILE_ZONE("frame graph build");
+            frameGraphConfiguration = configuration;
+            frameGraphRenderWidth = renderWidth;
+            frameGraphRenderHeight = renderHeight;
+            frameGraph.Reset();
+            int shadowCascades = frameGraph.Import("shadow cascades", shadowMap.depthArray);
+            int gAlbedo = frameGraph.CreateTexture("G-buffer albedo", width, height, GBUFFER_ALBEDO_FORMAT);
+            int gNormal = frameGraph.CreateTexture("G-buffer normal", width, height, GBUFFER_NORMAL_FORMAT);
+            int gDepth = frameGraph.CreateTexture("G-buffer depth", width, height, renderTargets.depthFormat);
+            int sceneColor = frameGraph.Import("scene color", renderTargets.sceneColor[0]);
+            int sceneBright = frameGraph.Import("scene bright", renderTargets.sceneColor[1]);
+            int sceneDepth = frameGraph.Import("scene depth");
+            // the bloom mips are borrowed from the pool by the bloom chain itself
+            int transparencyAccumulation = frameGraph.Import("transparency accumulation", renderTargets.transparencyAccumulation);
+            int transparencyWeight = frameGraph.Import("transparency weight", renderTargets.transparencyWeight);
+            int bloomResult = frameGraph.Import("bloom");
+            int windowTarget = frameGraph.Import("window");
+
+            frameGraph.AddPass("shadows")
+                    .Write(shadowCascades)
+                    .Execute([&]() {
+                for (Shader *depthShader : {&depthPrepassShader, &alphaTestedDepthShader}) {
+                    depthShader->use();
+                    depthShader->setMat4("view", glm::mat4(1.0f));
+                }
+                shadowMap.BeginCasters();
+                for (int cascade = 0; cascade < CascadedShadowMap::cascadeCount; cascade++) {
+                    for (Shader *depthShader : {&depthPrepassShader, &alphaTestedDepthShader}) {
+                        depthShader->use();
+                        depthShader->setMat4("projection", shadowMap.lightSpaceMatrices[cascade]);
+                    }
+                    // the opaque meshes from the position-only stream, the cutouts with their diffuse map so the
+                    // shadow has the same holes as the surface
+                    if (shadowMap.BeginStatic(cascade)) {
+                        depthPrepassShader.use();
+                        depthPrepassShader.setMat4("model", glm::mat4(1.0f));
+                        for (StaticBatcher::Batch& batch : staticBatcher.Batches()) {
+                            if (batch.materialClass == MATERIAL_OPAQUE && shadowMap.Intersects(cascade, batch.boundsMin, batch.boundsMax))
+                                batch.mesh.DrawDepth();
+                        }
+                        glBindVertexArray(sideVAO);
+                        glDrawArrays(GL_TRIANGLES, 0, 6);
+                        glBindVertexArray(0);
+                        alphaTestedDepthShader.use();
+                        alphaTestedDepthShader.setMat4("model", glm::mat4(1.0f));
+                        for (StaticBatcher::Batch& batch : staticBatcher.Batches()) {
+                            if (batch.materialClass == MATERIAL_ALPHA_TESTED && shadowMap.Intersects(cascade, batch.boundsMin, batch.boundsMax))
+                                batch.mesh.Draw(alphaTestedDepthShader);
+                        }
+                    }
+                    shadowMap.BeginDynamic(cascade);
+                    depthPrepassShader.use();
+                    for (const SceneObject& object : opaqueObjects) {
+                        if (object.isStatic || !shadowMap.Intersects(cascade, object.boundsMin, object.boundsMax))
+                            continue;
+                        depthPrepassShader.setMat4("model", object.transform);
+                        object.model->DrawDepth(MATERIAL_OPAQUE);
+                    }
+                    alphaTestedDepthShader.use();
+                    for (const SceneObject& object : opaqueObjects) {
+                        if (object.isStatic || !shadowMap.Intersects(cascade, object.boundsMin, object.boundsMax))
+                            continue;
+                        alphaTestedDepthShader.setMat4("model", object.transform);
+                        object.model->Draw(alphaTestedDepthShader, MATERIAL_ALPHA_TESTED);
+                    }
+                }
+                shadowMap.EndCasters();
+            });
+
+            frameGraph.AddPass("G-buffer")
+                    .Write(gAlbedo).Write(gNormal).Write(gDepth)
+                    .Execute([&, gAlbedo, gNormal, gDepth]() {
+                // geometry pass: opaque props, floor and wall into the G-buffer
+                gBuffer.Attach(frameGraph.Texture(gAlbedo), frameGraph.Texture(gNormal), frameGraph.Texture(gDepth), renderWidth, renderHeight);
+                glViewport(0, 0, renderWidth, renderHeight);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                glDisable(GL_BLEND);
+                // opaque meshes first, then the cutouts with the program that discards
+                Shader &gBufferShader = gBufferShaders.Get(0);
+                for (MaterialClass materialClass : {MATERIAL_OPAQUE, MATERIAL_ALPHA_TESTED}) {
+                    Shader &bucketShader = gBufferShaders.Get(ShaderVariants::Mask({materialClass == MATERIAL_ALPHA_TESTED}));
+                    bucketShader.use();
+                    bucketShader.setMat4("projection", projection);
+                    bucketShader.setMat4("view", view);
+                    // the static props are in the batches
+                    for (const SceneObject& object : opaqueObjects) {
+                        if (object.isStatic)
+                            continue;
+                        bucketShader.setMat4("model", object.transform);
+                        bucketShader.setMat3("normalMatrix", glm::mat3(view) * glm::transpose(glm::inverse(glm::mat3(object.transform))));
+                        object.model->Draw(bucketShader, materialClass);
+                    }
+                    bucketShader.setMat4("model", glm::mat4(1.0f));
+                    bucketShader.setMat3("normalMatrix", glm::mat3(view));
+                    staticBatcher.Draw(bucketShader, materialClass);
+                    forest.DrawMeshes(bucketShader, glm::mat3(view), materialClass);
+                }
+                gBufferShader.use();
+                gBufferShader.setMat4("model", glm::mat4(1.0f));
+                gBufferShader.setMat3("normalMatrix", glm::mat3(view));
+                // no specular maps, the specular mask is read from the diffuse texture like in the clustered path
+                gBufferShader.setInt("material.texture_diffuse1", 0);
+                gBufferShader.setInt("material.texture_specular1", 0);
+                gBufferShader.setFloat("material.diffuseLayer", -1.0f);
+                gBufferShader.setFloat("material.specularLayer", -1.0f);
+                glActiveTexture(GL_TEXTURE0);
+                glBindVertexArray(sideVAO);
+                glBindTexture(GL_TEXTURE_2D, sideTexture);
+                glDrawArrays(GL_TRIANGLES, 0, 6);
+                terrainGBufferShader.use();
+                terrainGBufferShader.setInt("material.texture_diffuse1", 0);
+                terrainGBufferShader.setInt("material.texture_specular1", 0);
+                terrainGBufferShader.setFloat("material.diffuseLayer", -1.0f);
+                terrainGBufferShader.setFloat("material.specularLayer", -1.0f);
+                glBindTexture(GL_TEXTURE_2D, floorTexture);
+                terrain.Draw(terrainGBufferShader, projection, view, programState->camera.Position);
+                Shader &impostorShader = *currentImpostorShader;
+                impostorShader.use();
+                forest.Draw(impostorShader, projection, view, programState->camera.Position);
+                Shader &hlodShader = *currentHlodShader;
+                hlodShader.use();
+                hlod.Draw(hlodShader, projection, view);
+                glEnable(GL_BLEND);
+            });
+
+            FrameGraph::PassBuilder scenePass = frameGraph.AddPass("scene")
+                    .Write(sceneColor).Write(sceneBright).Write(sceneDepth)
+                    .Target(renderTargets.sceneFBO, renderWidth, renderHeight)
+                    .Execute([&]() {
+                Shader &litShader = *currentLitShader;
+                glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+                if (renderPath == RENDER_PATH_DEFERRED) {
+                    // lighting pass: accumulate into the HDR buffer so bloom and tone mapping work unchanged
+                    gBuffer.BlitDepthTo(renderTargets.sceneFBO, renderWidth, renderHeight);
+                    glDisable(GL_DEPTH_TEST);
+                    glDisable(GL_BLEND);
+                    gBuffer.BindTextures();
+
+                    glm::mat4 inverseProjection = glm::inverse(projection);
+                    Shader &deferredDirShader = deferredDirShaders.Get(shadowVariant);
+                    deferredDirShader.use();
+                    deferredDirShader.setMat4("inverseProjection", inverseProjection);
+                    deferredDirShader.setMat4("inverseView", glm::inverse(view));
+                    deferredDirShader.setVec2("uvScale", renderUvScale);
+                    deferredDirShader.setVec3("dirLight.direction", glm::mat3(view) * sunDirection);
+                    deferredDirShader.setVec3("dirLight.ambient", glm::vec3(0.1f));
+                    deferredDirShader.setVec3("dirLight.diffuse", sunDiffuse);
+                    deferredDirShader.setVec3("dirLight.specular", glm::vec3(0.1f));
+                    deferredDirShader.setVec3("pointLight.position", glm::vec3(0.0f)); // follows the camera
+                    deferredDirShader.setVec3("pointLight.ambient", pointLight.ambient);
+                    deferredDirShader.setVec3("pointLight.diffuse", pointLight.diffuse);
+                    deferredDirShader.setFloat("pointLight.constant", pointLight.constant);
+                    deferredDirShader.setFloat("pointLight.linear", pointLight.linear);
+                    deferredDirShader.setFloat("pointLight.quadratic", pointLight.quadratic);
+                    shadowMap.Bind(deferredDirShader, 7);
+                    renderQuad(); // blending is still off, this overwrites the clear color wherever there is geometry
+
+                    glEnable(GL_BLEND);
+                    glBlendFunc(GL_ONE, GL_ONE);
+
+                    // every lamp is a quad over its projected bounding rectangle, lights off screen are dropped here
+                    lightInstances.clear();
+                    for (const LocalLight& light : lampLights) {
+                        glm::vec3 viewPosition = glm::vec3(view * glm::vec4(light.position, 1.0f));
+                        glm::vec4 rect;
+                        if (!SphereScreenRect(viewPosition, light.radius, projection, 0.1f, rect))
+                            continue;
+                        glm::vec3 viewDirection = glm::normalize(glm::mat3(view) * light.direction);
+                        float instance[lightInstanceFloats] = {
+                                rect.x, rect.y, rect.z, rect.w,
+                                viewPosition.x, viewPosition.y, viewPosition.z, light.radius,
+                                light.color.r, light.color.g, light.color.b, light.cosInnerCutOff,
+                                viewDirection.x, viewDirection.y, viewDirection.z, light.cosOuterCutOff
+                        };
+                        lightInstances.insert(lightInstances.end(), instance, instance + lightInstanceFloats);
+                    }
+                    if (!lightInstances.empty()) {
+                        deferredLightShader.use();
+                        deferredLightShader.setMat4("inverseProjection", inverseProjection);
+                        deferredLightShader.setVec2("uvScale", renderUvScale);
+                        glBindBuffer(GL_ARRAY_BUFFER, deferredLightInstanceVBO);
+                        glBufferData(GL_ARRAY_BUFFER, lightInstances.size() * sizeof(float), &lightInstances[0], GL_STREAM_DRAW);
+                        glBindVertexArray(deferredLightVAO);
+                        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, lightInstances.size() / lightInstanceFloats);
+                        glBindVertexArray(0);
+                    }
+
+                    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                    glEnable(GL_DEPTH_TEST);
+                }
+
+                if (depthPrepass && renderPath != RENDER_PATH_DEFERRED) {
+                    // Z pre-pass: lay down the depth of all opaque props with a trivial program so
+                    // the lighting pass below shades every pixel only once
+                    depthPrepassShader.use();
+                    depthPrepassShader.setMat4("projection", projection);
+                    depthPrepassShader.setMat4("view", view);
+                    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+                    // the cutouts would need their texture, they draw after the pre-pass
+                    for (const SceneObject& object : opaqueObjects) {
+                        if (object.isStatic)
+                            continue;
+                        depthPrepassShader.setMat4("model", object.transform);
+                        object.model->DrawDepth(MATERIAL_OPAQUE);
+                    }
+                    depthPrepassShader.setMat4("model", glm::mat4(1.0f));
+                    staticBatcher.DrawDepth();
+                    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+                    glDepthFunc(GL_EQUAL);
+                    glDepthMask(GL_FALSE);
+                    litShader.use();
+                }
+
+                // nothing in this pass is see-through, the blended meshes are drawn by the transparent pass
+                glDisable(GL_BLEND);
+                if (renderPath != RENDER_PATH_DEFERRED) {
+                    litShader.use();
+                    for (const SceneObject& object : opaqueObjects) {
+                        if (object.isStatic)
+                            continue;
+                        litShader.setMat4("model", object.transform);
+                        litShader.setMat3("normalMatrix", glm::transpose(glm::inverse(glm::mat3(object.transform))));
+                        object.model->Draw(litShader, MATERIAL_OPAQUE);
+                    }
+                    litShader.setMat4("model", glm::mat4(1.0f));
+                    litShader.setMat3("normalMatrix", glm::mat3(1.0f));
+                    staticBatcher.Draw(litShader, MATERIAL_OPAQUE);
+                }
+
+                if (depthPrepass && renderPath != RENDER_PATH_DEFERRED) {
+                    glDepthFunc(GL_LESS);
+                    glDepthMask(GL_TRUE);
+                }
+
+                if (renderPath != RENDER_PATH_DEFERRED) {
+                    // not in the pre-pass, the forest, the cutouts and the HLOD proxies draw after the depth test is
+                    // back to GL_LESS
+                    litShader.use();
+                    forest.DrawMeshes(litShader, glm::mat3(1.0f), MATERIAL_OPAQUE);
+                    Shader &alphaTestedShader = *currentAlphaTestedShader;
+                    alphaTestedShader.use();
+                    for (const SceneObject& object : opaqueObjects) {
+                        if (object.isStatic)
+                            continue;
+                        alphaTestedShader.setMat4("model", object.transform);
+                        alphaTestedShader.setMat3("normalMatrix", glm::transpose(glm::inverse(glm::mat3(object.transform))));
+                        object.model->Draw(alphaTestedShader, MATERIAL_ALPHA_TESTED);
+                    }
+                    alphaTestedShader.setMat4("model", glm::mat4(1.0f));
+                    alphaTestedShader.setMat3("normalMatrix", glm::mat3(1.0f));
+                    staticBatcher.Draw(alphaTestedShader, MATERIAL_ALPHA_TESTED);
+                    forest.DrawMeshes(alphaTestedShader, glm::mat3(1.0f), MATERIAL_ALPHA_TESTED);
+                    Shader &impostorShader = *currentImpostorShader;
+                    impostorShader.use();
+                    forest.Draw(impostorShader, projection, view, programState->camera.Position);
+                    Shader &hlodShader = *currentHlodShader;
+                    hlodShader.use();
+                    hlod.Draw(hlodShader, projection, view);
+                }
+
+
+                // in the deferred path the floor and the wall are already in the G-buffer
+                if (renderPath == RENDER_PATH_CLUSTERED) {
+                    // the lamps have to reach the ground, so floor and wall go through the clustered shader too
+                    litShader.use();
+                    litShader.setMat4("model", glm::mat4(1.0f));
+                    litShader.setMat3("normalMatrix", glm::mat3(1.0f));
+                    litShader.setInt("material.texture_diffuse1", 0);
+                    litShader.setFloat("material.diffuseLayer", -1.0f);
+                    litShader.setFloat("material.specularLayer", -1.0f);
+                    litShader.setInt("material.texture_specular1", 0);
+                    glActiveTexture(GL_TEXTURE0);
+                    glBindVertexArray(sideVAO);
+                    glBindTexture(GL_TEXTURE_2D, sideTexture);
+                    glDrawArrays(GL_TRIANGLES, 0, 6);
+                    Shader &terrainShader = *currentTerrainShader;
+                    terrainShader.use();
+                    terrainShader.setInt("material.texture_diffuse1", 0);
+                    terrainShader.setFloat("material.diffuseLayer", -1.0f);
+                    terrainShader.setFloat("material.specularLayer", -1.0f);
+                    terrainShader.setInt("material.texture_specular1", 0);
+                    glBindTexture(GL_TEXTURE_2D, floorTexture);
+                    terrain.Draw(terrainShader, projection, view, programState->camera.Position);
+                } else if (renderPath == RENDER_PATH_FORWARD) {
+                    unsigned int blinnVariant = ShaderVariants::Mask({blinn, shadows && sunUp});
+                    Shader &terrainShader = terrainForwardShaders.Get(blinnVariant);
+                    Shader &BlinnPhongshader = BlinnPhongshaders.Get(blinnVariant);
+                    // the floor is the terrain now, it shares the wall's fragment shader and its uniforms
+                    for (Shader *floorShader : {&terrainShader, &BlinnPhongshader}) {
+                        floorShader->use();
+
+                        floorShader->setMat4("projection", projection);
+                        floorShader->setMat4("view", view);
+                        // set light uniforms
+
+                        floorShader->setVec3("viewPos", programState->camera.Position);
+                        floorShader->setVec3("lightPos", lightPos);
+                        floorShader->setVec3("dirLight.direction", sunDirection);
+                        floorShader->setVec3("dirLight.diffuse", sunDiffuse);
+                        shadowMap.Bind(*floorShader, 7);
+                    }
+                    // floor
+                    terrainShader.use();
+                    glActiveTexture(GL_TEXTURE0);
+                    glBindTexture(GL_TEXTURE_2D, floorTexture);
+                    terrain.Draw(terrainShader, projection, view, programState->camera.Position);
+                    //zid
+                    BlinnPhongshader.use();
+
+                    glBindVertexArray(sideVAO);
+                    glActiveTexture(GL_TEXTURE0);
+                    glBindTexture(GL_TEXTURE_2D, sideTexture);
+                    glDrawArrays(GL_TRIANGLES, 0, 6);
+                }
+                glEnable(GL_BLEND);
+            });
+            if (shadows && sunUp)
+                scenePass.Read(shadowCascades);
+            if (renderPath == RENDER_PATH_DEFERRED)
+                scenePass.Read(gAlbedo).Read(gNormal).Read(gDepth);
+
+            // same framebuffer as the scene pass, no rebind in between
+            frameGraph.AddPass("vegetation and skybox")
+                    .Read(sceneDepth).Write(sceneColor).Write(sceneBright)
+                    .Target(renderTargets.sceneFBO, renderWidth, renderHeight)
+                    .Execute([&]() {
+                glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
+
+
+                grassShader.use();
+                glDisable(GL_CULL_FACE);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, GrassTexture);
+                vegetation.Draw(grassShader, projection, view, programState->camera.Position, animationTime);
+                /*
+                wallShader.use();
+                wallShader.setMat4("projection", projection);
+                wallShader.setMat4("view", view);
+                wallShader.setVec3("viewPos", programState->camera.Position);
+                model = glm::mat4(1.0f);
+                wallShader.setMat4("model", model);
+                wallShader.setFloat("height_scale", heightScale);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, diffuseMap);
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D, normalMap);
+                glActiveTexture(GL_TEXTURE2);
+                glBindTexture(GL_TEXTURE_2D, heightMap);
+
+                renderWall();
+                glDisable(GL_CULL_FACE);
+                */
+                //poslednji skybox
+                skyboxShader.use();
+                glm::mat4 skyboxView = view;
+                skyboxView[3][0] = 0; // Postavljam x translaciju na nulu
+                skyboxView[3][1] = 0; // Postavljam y translaciju na nulu
+                skyboxView[3][2] = 0; // postavljam z translaciju na nulu
+                skyboxView[3][3] = 0;
+                skyboxShader.setMat4("view", skyboxView);
+                skyboxShader.setMat4("projection", projection);
+
+                glBindVertexArray(skyboxVAO);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+                glBindVertexArray(0);
+                glDepthFunc(GL_LESS); // set depth function back to default
+            });
+
+            // blended geometry in any order: weighted color sum and revealage over the scene's depth, without
+            // writing it, then one full screen resolve over the scene color
+            frameGraph.AddPass("transparent")
+                    .Read(sceneDepth).Write(transparencyAccumulation).Write(transparencyWeight)
+                    .Target(renderTargets.transparencyFBO, renderWidth, renderHeight)
+                    .Execute([&]() {
+                const float clearAccumulation[] = { 0.0f, 0.0f, 0.0f, 1.0f };
+                const float clearWeight[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+                glClearBufferfv(GL_COLOR, 0, clearAccumulation);
+                glClearBufferfv(GL_COLOR, 1, clearWeight);
+                glDepthMask(GL_FALSE);
+                glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+
+                blendingShader.use();
+                blendingShader.setVec3("viewPosition", programState->camera.Position);
+                blendingShader.setFloat("material.shininess", 32.0f);
+                blendingShader.setMat4("projection", projection);
+                blendingShader.setMat4("view", view);
+                blendingShader.setVec3("dirLight.direction", glm::vec3(-0.547f, -0.727f, 0.415f));
+                blendingShader.setVec3("dirLight.ambient", glm::vec3(0.35f));
+                blendingShader.setVec3("dirLight.diffuse", glm::vec3(0.4f));
+                blendingShader.setVec3("dirLight.specular", glm::vec3(0.2f));
+                for (const SceneObject& object : opaqueObjects) {
+                    blendingShader.setMat4("model", object.transform);
+                    blendingShader.setMat3("normalMatrix", glm::transpose(glm::inverse(glm::mat3(object.transform))));
+                    object.model->Draw(blendingShader, MATERIAL_BLENDED);
+                }
+                blendingShader.setMat4("model", model2);
+                blendingShader.setMat3("normalMatrix", glm::transpose(glm::inverse(glm::mat3(model2))));
+                sunModel.Draw(blendingShader, MATERIAL_BLENDED);
+
+                glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                glDepthMask(GL_TRUE);
+            });
+
+            frameGraph.AddPass("transparency resolve")
+                    .Read(transparencyAccumulation).Read(transparencyWeight).Write(sceneColor).Write(sceneBright)
+                    .Target(renderTargets.sceneFBO, renderWidth, renderHeight)
+                    .Execute([&]() {
+                oitResolveShader.use();
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, renderTargets.transparencyAccumulation);
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D, renderTargets.transparencyWeight);
+                glActiveTexture(GL_TEXTURE0);
+                glDisable(GL_DEPTH_TEST);
+                renderQuad();
+                glEnable(GL_DEPTH_TEST);
+            });
+
+            // culled when bloom is off, the composite doesn't read it then
+            frameGraph.AddPass("bloom")
+                    .Read(sceneBright).Write(bloomResult)
+                    .Execute([&]() {
+                bloomChain.Render(renderTargets.pool, bloomDownsampleShader, bloomUpsampleShader, renderTargets.sceneColor[1], width, height, renderUvScale, renderQuad);
+            });
+
+            FrameGraph::PassBuilder compositePass = frameGraph.AddPass("composite")
+                    .Read(sceneColor).Write(windowTarget)
+                    .Target(outputFramebuffer, width, height)
+                    .SideEffect()
+                    .Execute([&]() {
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                //bloomShader.use();
+                Shader &HdrShader = HdrShaders.Get(ShaderVariants::Mask({hdr, bloom}));
+                HdrShader.use();
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, renderTargets.sceneColor[0]);
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D, bloom ? bloomChain.Result() : 0);
+                glActiveTexture(GL_TEXTURE0);
+                HdrShader.setFloat("bloomStrength", bloom ? 1.0f / bloomChain.Levels() : 0.0f);
+        //        bloomShader.setInt("bloom", bloom);
+        //        bloomShader.setFloat("exposure", exposure);
+                HdrShader.setFloat("exposure", exposure);
+                HdrShader.setVec2("uvScale", renderUvScale);
+                renderQuad();
+
+                if (bloom)
+                    bloomChain.Release(renderTargets.pool);
+
+            });
+            if (bloom)
+                compositePass.Read(bloomResult);
+
+            frameGraph.Compile();
+        }
 
+        {
+            PROFILE_ZONE("frame graph execute");
+            resolutionScaler.BeginFrame();
+            gpuProfiler.BeginFrame();
+            frameGraph.Execute(renderTargets.pool, &gpuProfiler);
+            resolutionScaler.EndFrame(dynamicResolution);
+            renderTargets.pool.EndFrame();
+        }
+        if (shadows && sunUp && frameIndex >= headless.warmupFrames) {
+            frameStatistics.shadowCascadeUpdates += CascadedShadowMap::cascadeCount;
+            frameStatistics.shadowStaticRedraws += shadowMap.staticRedraws;
+        }
 
-        blendingShader.setMat4("model", model2);
-        sunModel.Draw(blendingShader);
+        // the log repeats identical messages every few seconds, so check for a change here
+        if (hdr != loggedHdr || bloom != loggedBloom || exposure != loggedExposure) {
+            LOG_INFO("hdr: {} | bloom: {} | exposure: {}", hdr ? "on" : "off", bloom ? "on" : "off", exposure);
+            loggedHdr = hdr;
+            loggedBloom = bloom;
+            loggedExposure = exposure;
+        }
 
 
-        if (programState->ImGuiEnabled)
-            //DrawImGui(programState);
+        if (programState->ImGuiEnabled) {
+            PROFILE_ZONE("ImGui");
+            gpuProfiler.Begin("ImGui");
+            DrawImGui(programState, gpuProfiler);
+            gpuProfiler.End();
+        }
 
 
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        if (headless.enabled) {
+            // nothing is presented, wait for the GPU so the frame time includes its work
+            glFinish();
+            if (frameIndex >= headless.warmupFrames)
+                frameStatistics.milliseconds.push_back(
+                        std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+        } else {
+            PROFILE_ZONE("swap buffers");
+            glfwSwapBuffers(window);
+            framePacer.EndFrame();
+            glfwPollEvents();
+        }
+        frameIndex++;
     }
 
-    glDeleteVertexArrays(1, &planeVAO);
-    glDeleteBuffers(1, &planeVBO);
+    // a headless replay ends with the last frame of the path
+    cameraPath.Finish();
+
+    int exitCode = 0;
+    if (headless.enabled) {
+        vector<unsigned char> pixels = headlessContext.ReadPixels();
+        if (!headless.dumpPath.empty() && !WritePpm(headless.dumpPath, headless.width, headless.height, pixels))
+            LOG_ERROR("Failed to write {}", headless.dumpPath);
+        string golden;
+        if (!headless.goldenPath.empty()) {
+            int goldenWidth, goldenHeight;
+            vector<unsigned char> goldenPixels;
+            if (!ReadPpm(headless.goldenPath, goldenWidth, goldenHeight, goldenPixels) ||
+                goldenWidth != headless.width || goldenHeight != headless.height) {
+                LOG_ERROR("Golden image {} is missing or not {}x{}", headless.goldenPath, headless.width, headless.height);
+                golden = "{\"passed\": false}";
+                exitCode = 1;
+            } else {
+                float meanError, differingPixels;
+                CompareImages(pixels, goldenPixels, meanError, differingPixels);
+                bool passed = meanError <= headless.tolerance;
+                LOG_INFO("golden image: mean error {}, {} of the pixels differ, {}", meanError, differingPixels,
+                         passed ? "passed" : "FAILED");
+                golden = "{\"mean_error\": " + std::to_string(meanError) + ", \"differing_pixels\": " +
+                         std::to_string(differingPixels) + ", \"passed\": " + (passed ? "true" : "false") + "}";
+                exitCode = passed ? 0 : 1;
+            }
+        }
+        // the static casters should be redrawn only when the sun has turned or the camera has walked off
+        if (frameStatistics.shadowStaticRedraws * 10 > frameStatistics.shadowCascadeUpdates)
+            LOG_WARNING("shadow cache: {} of {} cascade updates redrew the static casters", frameStatistics.shadowStaticRedraws,
+                        frameStatistics.shadowCascadeUpdates);
+        if (!frameStatistics.WriteJson(headless.statsPath, headless, gpuProfiler, golden))
+            LOG_ERROR("Failed to write {}", headless.statsPath);
+    }
+
+    framePacer.Destroy();
+    vegetation.Destroy();
+    terrain.Destroy();
+    forest.Destroy();
+    hlod.Destroy();
+    bloomChain.Destroy();
+    gBuffer.Destroy();
+    renderTargets.Destroy();
 
     //glDeleteVertexArrays(1, &sideVAO);
     //glDeleteBuffers(1, &sideVBO);
 
-    programState->SaveToFile("resources/program_state.txt");
+    if (!headless.enabled)
+        programState->SaveToFile("resources/program_state.txt");
     delete programState;
-    ImGui_ImplOpenGL3_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
+    PROFILE_WRITE_TRACE("profile_trace.json");
+    if (!headless.enabled) {
+        ImGui_ImplOpenGL3_Shutdown();
+        ImGui_ImplGlfw_Shutdown();
+    }
     ImGui::DestroyContext();
+    if (headless.enabled) {
+        headlessContext.Destroy();
+        return exitCode;
+    }
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
     glfwTerminate();
     return 0;
 }
 
+unsigned int currentToggles() {
+    return (blinn ? 1 : 0) | (hdr ? 2 : 0) | (bloom ? 4 : 0) | (depthPrepass ? 8 : 0) | (shadows ? 16 : 0) |
+           (dynamicResolution ? 32 : 0) | (renderPath << 6);
+}
+
+void applyToggles(unsigned int toggles) {
+    blinn = toggles & 1;
+    hdr = toggles & 2;
+    bloom = toggles & 4;
+    depthPrepass = toggles & 8;
+    shadows = toggles & 16;
+    dynamicResolution = toggles & 32;
+    renderPath = (RenderPath) ((toggles >> 6) % 3);
+}
+
+void startReplay() {
+    swapIntervalBeforeReplay = framePacer.swapInterval;
+    framePacer.swapInterval = 0;
+    cameraPath.StartReplay();
+    LOG_INFO("replaying {} frames", cameraPath.FrameCount());
+}
+
+bool enableFeature(const std::string &name) {
+    if (name == "blinn")
+        blinn = true;
+    else if (name == "hdr")
+        hdr = true;
+    else if (name == "bloom")
+        bloom = true;
+    else if (name == "prepass")
+        depthPrepass = true;
+    else if (name == "shadows")
+        shadows = true;
+    else if (name == "dynamic-resolution")
+        dynamicResolution = true;
+    else if (name == "deferred")
+        renderPath = RENDER_PATH_DEFERRED;
+    else if (name == "clustered")
+        renderPath = RENDER_PATH_CLUSTERED;
+    else
+        return false;
+    return true;
+}
+
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
 void processInput(GLFWwindow *window) {
+    PROFILE_ZONE("processInput");
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
@@ -1006,7 +1694,7 @@ unsigned int loadTexture(char const * path)
     }
     else
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
+        LOG_ERROR("Texture failed to load at path: {}", path);
         stbi_image_free(data);
     }
 
@@ -1030,7 +1718,7 @@ unsigned int loadCubemap(vector<std::string> faces)
         }
         else
         {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
+            LOG_ERROR("Cubemap texture failed to load at path: {}", faces[i]);
             stbi_image_free(data);
         }
     }
@@ -1043,7 +1731,7 @@ unsigned int loadCubemap(vector<std::string> faces)
     return textureID;
 }
 
-void DrawImGui(ProgramState *programState) {
+void DrawImGui(ProgramState *programState, GpuProfiler &gpuProfiler) {
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
@@ -1074,6 +1762,50 @@ void DrawImGui(ProgramState *programState) {
         ImGui::End();
     }
 
+    {
+        ImGui::Begin("Frame pacing");
+        ImGui::SliderInt("Swap interval", &framePacer.swapInterval, 0, 2);
+        ImGui::DragFloat("FPS cap (0 = off)", &framePacer.targetFps, 1.0f, 0.0f, 500.0f);
+        ImGui::SliderInt("Frames in flight", &framePacer.framesInFlight, 1, FramePacer::maxFramesInFlight);
+        ImGui::Checkbox("Smooth delta time", &framePacer.smoothDeltaTime);
+        ImGui::Text("Frame: %.2f ms (smoothed %.2f ms)", framePacer.rawDeltaTime * 1000.0f, framePacer.deltaTime * 1000.0f);
+        ImGui::Text("Limiter: %.2f ms  fence wait: %.2f ms", framePacer.limiterMilliseconds, framePacer.fenceMilliseconds);
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Vegetation");
+        ImGui::Text("%d blades in %d chunks", vegetation.Blades(), vegetation.Chunks());
+        ImGui::Text("Drawn: %d blades in %d chunks", vegetation.drawnBlades, vegetation.visibleChunks);
+        ImGui::DragFloat("Fade start", &vegetation.fadeStart, 0.5f, 0.0f, 100.0f);
+        ImGui::DragFloat("Fade end", &vegetation.fadeEnd, 0.5f, 0.0f, 100.0f);
+        ImGui::DragFloat2("Wind direction", (float*)&vegetation.windDirection, 0.01f, -1.0f, 1.0f);
+        ImGui::DragFloat("Wind strength", &vegetation.windStrength, 0.01f, 0.0f, 1.0f);
+        ImGui::DragFloat("Wind speed", &vegetation.windSpeed, 0.05f, 0.0f, 10.0f);
+        ImGui::End();
+
+        ImGui::Begin("Terrain");
+        ImGui::Text("%.0f m, %d levels", terrain.Size(), terrain.Levels());
+        ImGui::Text("Drawn: %d chunks, %d triangles", terrain.drawnChunks, terrain.drawnTriangles);
+        ImGui::DragFloat("LOD distance", &terrain.lodDistance, 0.05f, 1.5f, 8.0f);
+        ImGui::DragFloat("Morph start", &terrain.morphStart, 0.01f, 0.0f, 0.95f);
+        ImGui::End();
+
+        ImGui::Begin("Forest");
+        ImGui::Text("%d trees", forest.Instances());
+        ImGui::Text("Drawn: %d meshes, %d impostors", forest.meshCount, forest.impostorCount);
+        ImGui::DragFloat("Impostor distance", &forest.distance, 0.5f, 0.0f, 100.0f);
+        ImGui::End();
+
+        ImGui::Begin("HLOD");
+        ImGui::Text("%d cells, %d as proxies, %d proxies drawn", hlod.Cells(), hlod.cellsProxied, hlod.proxiesDrawn);
+        ImGui::DragFloat("Proxy distance", &hlod.distance, 0.5f, 0.0f, 200.0f);
+        ImGui::Text("Static batches: %d of %d drawn", staticBatcher.batchesDrawn, (int) staticBatcher.Batches().size());
+        ImGui::End();
+    }
+
+    gpuProfiler.DrawImGui();
+
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
@@ -1110,6 +1842,48 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
         bloom = false;
         bloomKeyPressed = false;
     }
+
+    if(key == GLFW_KEY_Z && action == GLFW_PRESS){
+        depthPrepass = !depthPrepass;
+    }
+
+    if(key == GLFW_KEY_K && action == GLFW_PRESS){
+        shadows = !shadows;
+    }
+
+    if(key == GLFW_KEY_R && action == GLFW_PRESS){
+        dynamicResolution = !dynamicResolution;
+    }
+
+    if(key == GLFW_KEY_G && action == GLFW_PRESS){
+        renderPath = (RenderPath)((renderPath + 1) % 3);
+    }
+
+    if(key == GLFW_KEY_V && action == GLFW_PRESS){
+        framePacer.swapInterval = framePacer.swapInterval ? 0 : 1;
+    }
+
+    if(key == GLFW_KEY_F5 && action == GLFW_PRESS){
+        if (cameraPath.Recording()) {
+            cameraPath.StopRecording();
+            if (cameraPath.Save(cameraPathFile))
+                LOG_INFO("camera path saved to {}, {} frames", cameraPathFile, cameraPath.keyframes.size());
+        } else if (!cameraPath.Replaying()) {
+            cameraPath.StartRecording(glfwGetTime());
+            LOG_INFO("recording camera path");
+        }
+    }
+
+    if(key == GLFW_KEY_F6 && action == GLFW_PRESS && !cameraPath.Recording() && !cameraPath.Replaying()){
+        if (cameraPath.Load(cameraPathFile))
+            startReplay();
+        else
+            LOG_ERROR("No camera path in {}", cameraPathFile);
+    }
+
+    if(key == GLFW_KEY_F7 && action == GLFW_PRESS){
+        cameraPath.NewSegment();
+    }
 }
 unsigned int quadVAO = 0;
 unsigned int quadVBO;